@@ -0,0 +1,170 @@
+#include "BoundMethod.hpp"
+#include "MethodCall.hpp"
+#include "SmokeMethod.hpp"
+#include "SmokeObject.hpp"
+#include "Class.hpp"
+#include "RClass.hpp"
+#include "SmokeModule.hpp"
+
+#include "wrap.hpp"
+
+/* DynamicBinding keeps the name pointer, and we may outlive the R string */
+BoundMethod::BoundMethod(SEXP target, const char *methodName)
+  : DynamicBinding(qstrdup(methodName)), _target(target), _method(NULL),
+    _generation(RClass::generation()), _selected(false), _smokeMethod(NULL),
+    _checkedClass(NULL), _overrideClass(NULL), _overridden(false)
+{ }
+
+BoundMethod::BoundMethod(const Class *klass, const char *methodName)
+  : DynamicBinding(klass, qstrdup(methodName)), _target(NULL), _method(NULL),
+    _generation(RClass::generation()), _selected(false), _smokeMethod(NULL),
+    _checkedClass(NULL), _overrideClass(NULL), _overridden(false)
+{ }
+
+BoundMethod::~BoundMethod() {
+  reset();
+  delete[] name();
+}
+
+void BoundMethod::reset() {
+  if (_method && !_method->isShared())
+    delete _method;
+  _method = NULL;
+  _smokeMethod = NULL;
+  _checkedClass = NULL;
+  _overrideClass = NULL;
+}
+
+const Class *BoundMethod::klass() const {
+  if (_target)
+    return SmokeObject::fromSexp(_target)->klass();
+  return DynamicBinding::klass();
+}
+
+bool BoundMethod::select(const QList<QByteArray> &types) {
+  _selected = true;
+  _selectedTypes = types;
+  QList<Method *> meths = klass()->methods();
+  foreach(Method *m, meths) { // our own methods come before the inherited
+    bool matches = !_method && !qstrcmp(m->name(), name());
+    if (matches) {
+      QVector<SmokeType> mtypes = m->types();
+      matches = mtypes.size() == types.size() + 1;
+      for (int i = 0; matches && i < types.size(); i++)
+        matches = !qstrcmp(mtypes[i+1].name(), types[i]);
+    }
+    if (matches)
+      _method = m;
+    else delete m;
+  }
+  if (_method)
+    prepare();
+  return _method;
+}
+
+void BoundMethod::prepare() {
+  _generation = RClass::generation();
+  _smokeMethod = dynamic_cast<SmokeMethod *>(_method);
+  if (!_smokeMethod)
+    return;
+  _argTypes = _smokeMethod->types();
+  _marshalFns.resize(_argTypes.size());
+  for (int i = 0; i < _argTypes.size(); i++)
+    _marshalFns[i] = MethodCall::marshalFn(_argTypes[i]);
+}
+
+SEXP BoundMethod::invoke(SEXP obj, SEXP args) {
+  SEXP ans = NULL;
+  if (_generation != RClass::generation()) { // R methods might have changed
+    reset();
+    _generation = RClass::generation();
+    if (_selected)
+      select(_selectedTypes);
+  }
+  if (!_method && _selected) { // the selected method has been removed
+    setLastError(ImplementationMissing);
+    return ans;
+  }
+  if (!_method) { // resolve by the arguments of the first call
+    MethodCall call(this, obj, args);
+    _method = resolve(call);
+    if (!_method) {
+      setLastError(methodNotFound(call));
+      return ans;
+    }
+    prepare();
+  }
+  if (obj && overriddenBy(SmokeObject::fromSexp(obj)->klass())) {
+    DynamicBinding binding(name());
+    ans = binding.invoke(obj, args);
+    setLastError(binding.lastError());
+    return ans;
+  }
+  if (_smokeMethod) {
+    if (length(args) != _argTypes.size() - 1) {
+      setLastError(BadArguments);
+      return ans;
+    }
+    MethodCall call(_smokeMethod, obj, args, _argTypes,
+                    _marshalFns.constData());
+    call.eval();
+    ans = call.sexp();
+  } else ans = _method->invoke(obj, args);
+  setLastError(_method->lastError());
+  return ans;
+}
+
+bool BoundMethod::appliesTo(const SmokeObject *obj) const {
+  if (!_method || obj->klass() == _checkedClass)
+    return true;
+  bool applies;
+  if (_smokeMethod)
+    applies = SmokeModule::isDerivedFrom(obj->smoke(), obj->classId(),
+                                         _smokeMethod->smoke(),
+                                         _smokeMethod->classId());
+  else applies = obj->klass() == _method->klass();
+  if (applies)
+    _checkedClass = obj->klass();
+  return applies;
+}
+
+/* As in RSmokeBinding::findImplementor(), we look for an R
+   implementation in the R classes between the class and its Smoke
+   base. The resolved method's own class does not count. */
+bool BoundMethod::overriddenBy(const Class *klass) const {
+  if (klass == _overrideClass)
+    return _overridden;
+  bool impl = false;
+  const Class *c = klass;
+  QList<const Class *> p = c->parents();
+  while(p.size() == 1 && c->smokeBase() == p[0]->smokeBase() && !impl &&
+        c != _method->klass()) {
+    impl = c->implementsMethod(name());
+    c = p[0];
+    p = c->parents();
+  }
+  _overrideClass = klass;
+  _overridden = impl;
+  return impl;
+}
+
+static void finalizeBoundMethod(SEXP sexp) {
+  delete reinterpret_cast<BoundMethod *>(R_ExternalPtrAddr(sexp));
+  R_ClearExternalPtr(sexp);
+}
+
+/* The pointer protects the target, so that it outlives the binding */
+SEXP BoundMethod::sexp() {
+  SEXP ans = wrapPointer(this, QList<QByteArray>() << "BoundMethod",
+                         finalizeBoundMethod);
+  if (_target)
+    R_SetExternalPtrProtected(ans, _target);
+  return ans;
+}
+
+BoundMethod *BoundMethod::fromSexp(SEXP sexp) {
+  BoundMethod *bound = unwrapPointer(sexp, BoundMethod);
+  if (!bound)
+    error("Bound method is no longer valid");
+  return bound;
+}
@@ -0,0 +1,67 @@
+#ifndef BOUND_METHOD_H
+#define BOUND_METHOD_H
+
+#include <QList>
+#include <QByteArray>
+
+#include "DynamicBinding.hpp"
+#include "TypeHandler.hpp"
+
+class SmokeMethod;
+class SmokeObject;
+
+/*
+  A DynamicBinding that is resolved once and then invoked many
+  times. The method is selected either by its argument types, or by
+  the arguments of the first call. For a Smoke method, we also look up
+  the marshalling function for each type ahead of time, so that a call
+  goes straight to the marshalling.
+*/
+
+class BoundMethod : public DynamicBinding {
+public:
+  /* Bind an object method */
+  BoundMethod(SEXP target, const char *methodName);
+  /* Bind a static method */
+  BoundMethod(const Class *klass, const char *methodName);
+  virtual ~BoundMethod();
+
+  /* Select the overload with these argument types */
+  bool select(const QList<QByteArray> &types);
+  
+  using DynamicBinding::invoke;
+  virtual SEXP invoke(SEXP obj, SEXP args);
+  inline SEXP invoke(SEXP args) { return invoke(_target, args); }
+
+  virtual const Class *klass() const;
+  
+  inline SEXP target() const { return _target; }
+  /* Whether the resolved method can be called on 'obj', i.e., on
+     objects other than the target. */
+  bool appliesTo(const SmokeObject *obj) const;
+  /* Whether an R class of 'klass' overrides the resolved method, so
+     that calls need to be dispatched like qinvoke() */
+  bool overriddenBy(const Class *klass) const;
+  
+  SEXP sexp();
+  static BoundMethod *fromSexp(SEXP sexp);
+  
+private:
+
+  void prepare();
+  void reset();
+  
+  SEXP _target;
+  Method *_method;
+  unsigned int _generation; // of RClass, when _method was resolved
+  bool _selected; // by types, rather than by the first call
+  QList<QByteArray> _selectedTypes;
+  SmokeMethod *_smokeMethod;
+  QVector<SmokeType> _argTypes;
+  QVector<TypeHandler::MarshalFn> _marshalFns;
+  mutable const Class *_checkedClass;
+  mutable const Class *_overrideClass; // last checked by overriddenBy()
+  mutable bool _overridden;
+};
+
+#endif
@@ -0,0 +1,112 @@
+#include "CallProfiler.hpp"
+#include "Class.hpp"
+
+#include <Rinternals.h>
+
+bool CallProfiler::_enabled = false;
+QElapsedTimer CallProfiler::_timer;
+QHash<CallProfiler::Key, CallProfiler::Entry *> CallProfiler::_entries;
+QHash<NameKey, const char *> CallProfiler::_names;
+
+void CallProfiler::setEnabled(bool enabled) {
+  if (enabled && !_timer.isValid())
+    _timer.start();
+  _enabled = enabled;
+}
+
+/* Method names may come from R, so the pointers are not unique */
+const char *CallProfiler::intern(const char *name) {
+  const char *interned = _names.value(name);
+  if (!interned) {
+    interned = qstrdup(name);
+    _names.insert(interned, interned);
+  }
+  return interned;
+}
+
+void CallProfiler::record(const Class *klass, const char *methodName,
+                          Phase phase, qint64 nsecs)
+{
+  Key key(klass, intern(methodName));
+  Entry *entry = _entries.value(key);
+  if (!entry) {
+    entry = new Entry;
+    memset(entry->phases, 0, sizeof(entry->phases));
+    entry->className = klass->name();
+    entry->methodName = key.second;
+    _entries.insert(key, entry);
+  }
+  Stats &stats = entry->phases[phase];
+  stats.count++;
+  stats.total += nsecs;
+  int bucket = 0; // floor(log2(nsecs))
+  while (nsecs > 1 && bucket < NumBuckets - 1) {
+    nsecs >>= 1;
+    bucket++;
+  }
+  stats.histogram[bucket]++;
+}
+
+void CallProfiler::reset() {
+  qDeleteAll(_entries);
+  _entries.clear();
+}
+
+static const char *phaseNames[] = { "resolve", "marshal", "invoke",
+                                    "unmarshal" };
+
+enum { PROF_CLASS, PROF_METHOD, PROF_PHASE, PROF_COUNT, PROF_TOTAL,
+       PROF_HISTOGRAM, PROF_LAST };
+
+SEXP CallProfiler::report() {
+  int n = 0;
+  foreach(Entry *entry, _entries)
+    for (int p = 0; p < NumPhases; p++)
+      n += entry->phases[p].count > 0;
+  
+  SEXP result, rclass, rmethod, rphase, rcount, rtotal, rhist;
+  PROTECT(result = allocVector(VECSXP, PROF_LAST));
+  rclass = allocVector(STRSXP, n);
+  SET_VECTOR_ELT(result, PROF_CLASS, rclass);
+  rmethod = allocVector(STRSXP, n);
+  SET_VECTOR_ELT(result, PROF_METHOD, rmethod);
+  rphase = allocVector(STRSXP, n);
+  SET_VECTOR_ELT(result, PROF_PHASE, rphase);
+  rcount = allocVector(REALSXP, n);
+  SET_VECTOR_ELT(result, PROF_COUNT, rcount);
+  rtotal = allocVector(REALSXP, n);
+  SET_VECTOR_ELT(result, PROF_TOTAL, rtotal);
+  rhist = allocMatrix(REALSXP, n, NumBuckets);
+  SET_VECTOR_ELT(result, PROF_HISTOGRAM, rhist);
+  
+  int i = 0;
+  foreach(Entry *entry, _entries) {
+    for (int p = 0; p < NumPhases; p++) {
+      const Stats &stats = entry->phases[p];
+      if (!stats.count)
+        continue;
+      SET_STRING_ELT(rclass, i, mkChar(entry->className.constData()));
+      SET_STRING_ELT(rmethod, i, mkChar(entry->methodName));
+      SET_STRING_ELT(rphase, i, mkChar(phaseNames[p]));
+      REAL(rcount)[i] = stats.count;
+      REAL(rtotal)[i] = stats.total / 1000.0;
+      for (int b = 0; b < NumBuckets; b++)
+        REAL(rhist)[i + b * n] = stats.histogram[b];
+      i++;
+    }
+  }
+  
+  UNPROTECT(1);
+  return result;
+}
+
+extern "C"
+SEXP qt_qprofile(SEXP enable, SEXP reset) {
+  SEXP ans = PROTECT(CallProfiler::report());
+  if (asLogical(reset))
+    CallProfiler::reset();
+  if (enable != R_NilValue)
+    CallProfiler::setEnabled(asLogical(enable));
+  UNPROTECT(1);
+  return ans;
+}
@@ -0,0 +1,65 @@
+#ifndef CALL_PROFILER_H
+#define CALL_PROFILER_H
+
+#include <QHash>
+#include <QPair>
+#include <QByteArray>
+#include <QElapsedTimer>
+
+#include "NameKey.hpp"
+
+typedef struct SEXPREC* SEXP;
+
+class Class;
+
+/* Opt-in profiler of method calls. For each method, it counts the
+   calls and the time spent in each phase of a call: resolving the
+   method, marshalling the arguments, invoking the method and
+   marshalling the return value. Time is kept as a total and as a
+   histogram with power-of-two buckets. When disabled, the cost is a
+   test of a static flag.
+*/
+class CallProfiler {
+public:
+  enum Phase { Resolve, Marshal, Invoke, Unmarshal, NumPhases };
+  enum { NumBuckets = 40 }; // 2^40 ns is about 18 minutes
+
+  static inline bool enabled() { return _enabled; }
+  static void setEnabled(bool enabled);
+  
+  /* Monotonic time, in nanoseconds */
+  static inline qint64 now() { return _timer.nsecsElapsed(); }
+  
+  static void record(const Class *klass, const char *methodName,
+                     Phase phase, qint64 nsecs);
+  static void reset();
+  /* List of class, method, phase, count, total (microseconds) and
+     a histogram matrix (counts per bucket) */
+  static SEXP report();
+  
+private:
+  struct Stats {
+    double count;
+    qint64 total;
+    double histogram[NumBuckets];
+  };
+  struct Entry {
+    QByteArray className; // the class might not outlive the entry
+    const char *methodName;
+    Stats phases[NumPhases];
+  };
+  typedef QPair<const Class *, const char *> Key;
+
+  static const char *intern(const char *name);
+  
+  static bool _enabled;
+  static QElapsedTimer _timer;
+  /* By class and interned method name, so that recording a call
+     does not allocate */
+  static QHash<Key, Entry *> _entries;
+  static QHash<NameKey, const char *> _names;
+
+  CallProfiler() { }
+};
+
+#endif
@@ -7,11 +7,15 @@
 #include "InstanceObjectTable.hpp"
 #include "smoke.hpp"
 #include "SmokeType.hpp"
+#include "Property.hpp"
+#include "SmokeClass.hpp"
+#include "PreservePool.hpp"
+#include "wrap.hpp"
 
 #include <Rinternals.h>
 
 ClassFactory *Class::_classFactory = NULL;
-QHash<QByteArray, const Class *> Class::_classMap;
+QHash<NameKey, const Class *> Class::_classMap;
 
 ClassFactory *Class::classFactory() {
   if (!_classFactory) _classFactory = new ClassFactory;
@@ -20,17 +24,17 @@ ClassFactory *Class::classFactory() {
 
 const Class* Class::fromSmokeId(Smoke *smoke, int classId) {
   const char *name = smoke->classes[classId].className;
-  const Class *klass = _classMap[name];
+  const Class *klass = _classMap.value(name);
   if (!klass) {
     if (smoke->classes[classId].external) { // ensure we have actual class
-      Smoke::ModuleIndex mi = Smoke::classMap[name];
+      Smoke::ModuleIndex mi = Smoke::findClass(name);
       if (mi.index) {
         smoke = mi.smoke;
         classId = mi.index;
       } // else we have a ghost class; we have done the best we could
     }
     klass = classFactory()->createClass(smoke, classId);
-    _classMap[name] = klass;
+    _classMap.insert(name, klass);
   }
   return klass;
 }
@@ -39,50 +43,98 @@ const Class* Class::fromSmokeType(const SmokeType &type) {
 }
 const Class* Class::fromSmokeName(Smoke *smoke, const char *name) {
   if (!smoke) {
-    Smoke::ClassMap::iterator i = Smoke::classMap.find(name);
-    if (i == Smoke::classMap.end()) {
+    smoke = Smoke::findClass(name).smoke;
+    if (!smoke) {
       qCritical("No smoke found for class: %s", name);
       return NULL;
-    } else smoke = i->second.smoke;
+    }
   }
   return fromSmokeId(smoke, smoke->idClass(name).index);
 }
 const Class* Class::fromName(const char *name) {
-  const Class *klass = _classMap[name];
+  const Class *klass = _classMap.value(name);
   if (!klass)
     klass = fromSmokeName(NULL, name);
   return klass;
 }
 const Class* Class::fromMetaObject(const QMetaObject *meta) {
-  const Class *klass = _classMap[meta->className()];
+  const Class *klass = _classMap.value(meta->className());
   if (!klass) {
     klass = classFactory()->createClass(meta);
-    _classMap[meta->className()] = klass;
+    _classMap.insert(meta->className(), klass);
   }
   return klass;
 }
 
+static SEXP classHandleTag() {
+  static SEXP tag = install("Class");
+  return tag;
+}
+
 const Class* Class::fromSexp(SEXP sexp, bool forceNew) {
   static SEXP nameSym = install("name");
+  static SEXP handleSym = install(".handle");
   const Class *klass = NULL;
+  if (!forceNew) {
+    SEXP handle = getAttrib(sexp, handleSym);
+    if (TYPEOF(handle) == EXTPTRSXP &&
+        R_ExternalPtrTag(handle) == classHandleTag())
+    {
+      klass = static_cast<const Class *>(R_ExternalPtrAddr(handle));
+      if (klass)
+        return klass;
+    }
+  }
   if (inherits(sexp, "RQtClass")) {
     const char *name = CHAR(asChar(getAttrib(sexp, nameSym)));
-    klass = _classMap[name];
+    klass = _classMap.value(name);
     // FIXME: forceNew will leak; who cares?
     if (!klass || forceNew) {
       if (inherits(sexp, "RQtSmokeClass"))
         klass = Class::fromSmokeName(NULL, name);
       else if (inherits(sexp, "RQtUserClass")) {
+        if (klass) // stale handles would find the old class
+          klass->invalidateHandle();
         klass = new RClass(sexp);
-        _classMap[name] = klass;
+        _classMap.remove(name); // the key would still be the old name
+        _classMap.insert(klass->name(), klass);
       }
     }
+    if (klass)
+      setAttrib(sexp, handleSym, klass->handle());
   } else qCritical("Unknown R class representation");
   return klass;
 }
 
 /* Object methods */
 
+Class::~Class() {
+  invalidateHandle();
+  if (_instanceClasses)
+    PreservePool::release(_instanceClasses);
+  if (_handleClasses)
+    PreservePool::release(_handleClasses);
+  foreach(SEXP body, _methodClosureBodies)
+    PreservePool::release(body);
+}
+
+SEXP Class::handle() const {
+  if (!_handle) {
+    _handle = R_MakeExternalPtr(const_cast<Class *>(this), classHandleTag(),
+                                R_NilValue);
+    PreservePool::preserve(_handle);
+  }
+  return _handle;
+}
+
+void Class::invalidateHandle() const {
+  if (_handle) {
+    R_ClearExternalPtr(_handle);
+    PreservePool::release(_handle);
+    _handle = NULL;
+  }
+}
+
 QList<const Class *> Class::ancestors() const {
   QList<const Class *> _parents = parents();
   QList<const Class *> classes = _parents;
@@ -92,6 +144,84 @@ QList<const Class *> Class::ancestors() const {
   return classes;
 }
 
+SEXP Class::instanceClasses() const {
+  if (!_instanceClasses)
+    _instanceClasses = createInstanceClasses(false);
+  return _instanceClasses;
+}
+
+SEXP Class::handleClasses() const {
+  if (!_handleClasses)
+    _handleClasses = createInstanceClasses(true);
+  return _handleClasses;
+}
+
+SEXP Class::createInstanceClasses(bool handle) const {
+  QList<const Class *> classes = ancestors();
+  classes.prepend(this);
+  SEXP rclasses = allocVector(STRSXP, classes.size() + (handle ? 2 : 3));
+  PreservePool::preserve(rclasses);
+  for (int i = 0; i < classes.size(); i++)
+    SET_STRING_ELT(rclasses, i, mkChar(classes[i]->name()));
+  if (handle)
+    SET_STRING_ELT(rclasses, length(rclasses) - 2, mkChar("RQtHandle"));
+  else {
+    SET_STRING_ELT(rclasses, length(rclasses) - 3,
+                   mkChar("UserDefinedDatabase"));
+    SET_STRING_ELT(rclasses, length(rclasses) - 2, mkChar("environment"));
+  }
+  SET_STRING_ELT(rclasses, length(rclasses) - 1, mkChar("RQtObject"));
+  markShared(rclasses);
+  return rclasses;
+}
+
+SEXP Class::enumValue(const char *name) const {
+  const SmokeClass::EnumValue *value = smokeBase()->findEnumValue(name);
+  return value ? value->sexp : R_UnboundValue;
+}
+
+int Class::memberKinds(const char *name) const {
+  if (_memberGeneration != RClass::generation()) {
+    _memberKinds.clear();
+    _memberGeneration = RClass::generation();
+  }
+  QHash<NameKey, int>::const_iterator it = _memberKinds.constFind(name);
+  if (it != _memberKinds.constEnd())
+    return it.value();
+  int kinds = NoMember;
+  if (smokeBase()->findEnumValue(name))
+    kinds |= EnumMember;
+  if (hasMethod(name)) {
+    kinds |= MethodMember;
+    if (hasMethod(name, Method::Public | Method::NotStatic))
+      kinds |= PublicMethodMember;
+  }
+  Property *prop = property(name);
+  if (prop) {
+    kinds |= PropertyMember;
+    delete prop;
+  }
+  // symbol names live forever, so they can serve as keys
+  _memberKinds.insert(CHAR(PRINTNAME(install(name))), kinds);
+  return kinds;
+}
+
+SEXP Class::methodClosureBody(const char *name) const {
+  static SEXP qinvokeSym = install("qinvoke");
+  static SEXP selfSym = install("self");
+  SEXP body = _methodClosureBodies.value(name);
+  if (!body) {
+    SEXP rname = mkString(name);
+    PROTECT(rname);
+    body = lang4(qinvokeSym, selfSym, rname, R_DotsSymbol);
+    PreservePool::preserve(body);
+    UNPROTECT(1);
+    // the key borrows the name from the body
+    _methodClosureBodies.insert(CHAR(STRING_ELT(rname, 0)), body);
+  }
+  return body;
+}
+
 InstanceObjectTable *Class::createObjectTable(SmokeObject *obj) const {
   return new InstanceObjectTable(obj);
 }
@@ -4,6 +4,7 @@
 #include <QHash>
 
 #include "Method.hpp" // for Method::Qualifiers
+#include "NameKey.hpp"
 
 class MethodCall;
 class SmokeClass;
@@ -18,12 +19,16 @@ typedef struct SEXPREC* SEXP;
 class Class {
 public:
 
+  Class() : _handle(NULL), _instanceClasses(NULL), _handleClasses(NULL),
+            _memberGeneration(0) { }
+  
   /* Virtual interface */
 
-  virtual ~Class() { }
+  virtual ~Class();
   
   virtual const char* name() const = 0;
   
+  /* Delete the result, unless it isShared() */
   virtual Method *findMethod(const MethodCall &call) const = 0;
   virtual QList<Method *> methods(Method::Qualifiers qualifiers = Method::None)
     const = 0;
@@ -52,6 +57,35 @@ public:
   
   QList<const Class *> ancestors() const;
 
+  /* The class attribute of instances: this class, its ancestors and
+     the R classes of the environment. Computed once and shared by
+     all instances, so it must never be modified in place. */
+  SEXP instanceClasses() const;
+  /* The same for the lightweight handles of instances (see
+     SmokeObject::handleSexp()), which are not environments */
+  SEXP handleClasses() const;
+
+  /* The QtEnum for an enum value, shared by all lookups, or
+     R_UnboundValue if there is no such value */
+  SEXP enumValue(const char *name) const;
+  
+  /* Kinds of member that a name refers to, for resolving names in
+     instance environments. Cached per name, including names that are
+     not members, until an R class changes. */
+  enum MemberKind {
+    NoMember = 0,
+    EnumMember = 1 << 0,
+    MethodMember = 1 << 1,       // any method
+    PublicMethodMember = 1 << 2, // public, non-static method
+    PropertyMember = 1 << 3
+  };
+  int memberKinds(const char *name) const;
+  
+  /* Body of the R closure for a method, qinvoke(self, name, ...). It
+     is shared by the closures for all instances, which find 'self' in
+     their environment. */
+  SEXP methodClosureBody(const char *name) const;
+
   // Often want to know this to optimize e.g. callback handlers
   bool userImplementsMethod(const char *methodName) const;
 
@@ -80,6 +114,12 @@ public:
   static const Class* fromSexp(SEXP sexp, bool forceNew = false);
   static const Class* fromMetaObject(const QMetaObject *meta);
   
+  /* The R class object caches its Class in an attribute, as an
+     externalptr with an identity tag. Invalidating the handle forces
+     the next lookup through the class map. */
+  SEXP handle() const;
+  void invalidateHandle() const;
+  
   static ClassFactory *classFactory();
   static void setClassFactory(ClassFactory *factory) {
     if (factory) _classFactory = factory;
@@ -87,7 +127,16 @@ public:
   
 private:
   static ClassFactory *_classFactory;
-  static QHash<QByteArray, const Class *> _classMap;
+  static QHash<NameKey, const Class *> _classMap; // keys outlive the classes
+
+  SEXP createInstanceClasses(bool handle) const;
+
+  mutable SEXP _handle;
+  mutable SEXP _instanceClasses;
+  mutable SEXP _handleClasses;
+  mutable QHash<NameKey, SEXP> _methodClosureBodies;
+  mutable QHash<NameKey, int> _memberKinds;
+  mutable unsigned int _memberGeneration;
 
 };
 
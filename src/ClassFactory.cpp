@@ -1,15 +1,13 @@
-#include <qt_smoke.h>
-
 #include "ClassFactory.hpp"
 #include "SmokeClass.hpp"
 #include "MocClass.hpp"
+#include "SmokeModule.hpp"
 
 Class *ClassFactory::createClass(Smoke *smoke, int classId) {
-  static int QObjectId = qt_Smoke->idClass("QObject").index;
   Class *klass = NULL;
   if (classId > 0 && classId <= smoke->numClasses) {
     klass = new SmokeClass(smoke, classId);
-    if (smoke->isDerivedFrom(smoke, classId, qt_Smoke, QObjectId)) {
+    if (SmokeModule::isDerivedFrom(smoke, classId, "QObject")) {
       klass = new MocClass(klass);
     }
   }
@@ -122,9 +122,9 @@ bool DataFrameModel::setData(const QModelIndex &index, const QVariant &value,
     return(false);
 
   SEXP tmpDataframe = duplicate(_dataframe);
-  R_ReleaseObject(_dataframe);
+  PreservePool::release(_dataframe);
   _dataframe = tmpDataframe;
-  R_PreserveObject(_dataframe);
+  PreservePool::preserve(_dataframe);
 
   SEXP v = VECTOR_ELT(_dataframe, dfIndex);
   bool success = qvariant_into_vector(value, v, row);
@@ -232,10 +232,10 @@ void DataFrameModel::endChanges(int oldnr, int oldnc) {
 void DataFrameModel::setDataFrame(SEXP dataframe, SEXP roles, SEXP rowHeader,
                                   SEXP colHeader)
 {
-  R_PreserveObject(dataframe);
-  R_PreserveObject(roles);
-  R_PreserveObject(rowHeader);
-  R_PreserveObject(colHeader);
+  PreservePool::preserve(dataframe);
+  PreservePool::preserve(roles);
+  PreservePool::preserve(rowHeader);
+  PreservePool::preserve(colHeader);
 
   // need dimension changes up-front
   beginChanges(headerLength(rowHeader), headerLength(colHeader));
@@ -253,12 +253,12 @@ void DataFrameModel::setDataFrame(SEXP dataframe, SEXP roles, SEXP rowHeader,
 }
 
 DataFrameModel::~DataFrameModel() {
-  R_ReleaseObject(_dataframe);
-  R_ReleaseObject(_roles);
-  R_ReleaseObject(_rowHeader);
-  R_ReleaseObject(_colHeader);
-  R_ReleaseObject(_useRoles);
-  R_ReleaseObject(_editable);
+  PreservePool::release(_dataframe);
+  PreservePool::release(_roles);
+  PreservePool::release(_rowHeader);
+  PreservePool::release(_colHeader);
+  PreservePool::release(_useRoles);
+  PreservePool::release(_editable);
 }
 
 extern "C"
@@ -3,6 +3,8 @@
 #include <QAbstractTableModel>
 #include <Rinternals.h>
 
+#include "PreservePool.hpp"
+
 class DataFrameModel : public QAbstractTableModel {
   Q_OBJECT
 
@@ -13,8 +15,8 @@ public:
 	_roles(R_NilValue), _rowHeader(R_NilValue), _colHeader(R_NilValue),
 	_useRoles(useRoles), _editable(editable)
   {
-    R_PreserveObject(_useRoles);
-    R_PreserveObject(_editable);
+    PreservePool::preserve(_useRoles);
+    PreservePool::preserve(_editable);
   }
   
   ~DataFrameModel();
@@ -0,0 +1,52 @@
+#include <QCoreApplication>
+
+#include "DestructionQueue.hpp"
+#include "SmokeObject.hpp"
+
+QVector<SmokeObject *> DestructionQueue::_queue;
+int DestructionQueue::_size = 0;
+bool DestructionQueue::_scheduled = false;
+bool DestructionQueue::_draining = false;
+
+void DestructionQueue::enqueue(SmokeObject *obj) {
+  if (obj->_queueIndex >= 0)
+    return;
+  obj->_queueIndex = _queue.size();
+  _queue.append(obj);
+  _size++;
+  if (!_scheduled)
+    schedule();
+}
+
+void DestructionQueue::remove(SmokeObject *obj) {
+  _queue[obj->_queueIndex] = NULL;
+  obj->_queueIndex = -1;
+  _size--;
+}
+
+void DestructionQueue::schedule() {
+  if (!QCoreApplication::instance())
+    return;
+  static DestructionQueueDrainer *drainer = new DestructionQueueDrainer;
+  _scheduled = true;
+  QMetaObject::invokeMethod(drainer, "drain", Qt::QueuedConnection);
+}
+
+/* Destroying one object might delete others in the queue (its
+   children), or finalize more R references, which appends to the
+   queue; hence the index loop. */
+void DestructionQueue::drain() {
+  _scheduled = false;
+  if (_draining)
+    return;
+  _draining = true;
+  for (int i = 0; i < _queue.size(); i++) {
+    SmokeObject *obj = _queue[i];
+    if (!obj)
+      continue;
+    remove(obj);
+    obj->destroy();
+  }
+  _queue.clear();
+  _draining = false;
+}
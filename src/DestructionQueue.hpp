@@ -0,0 +1,49 @@
+#ifndef DESTRUCTION_QUEUE_H
+#define DESTRUCTION_QUEUE_H
+
+#include <QObject>
+#include <QVector>
+
+class SmokeObject;
+
+/* Objects whose last R reference is collected are destroyed here,
+   rather than in the finalizer. Running a C++ destructor during a
+   collection is risky (the destructor may call back into R) and slow
+   (each one resolves the destructor by name). The queue collects the
+   objects and destroys them in one batch on the next tick of the
+   event loop, or when the queue grows long, at the start of the next
+   call from R. An object might gain an owner while queued, so
+   ownership is checked again before destruction. A queued object
+   that Qt deletes first is simply dropped from the queue.
+*/
+class DestructionQueue {
+public:
+  static void enqueue(SmokeObject *obj);
+  static void remove(SmokeObject *obj);
+  static void drain();
+
+  static inline int size() { return _size; }
+  static inline bool isFull() { return _size >= BatchSize; }
+
+private:
+  enum { BatchSize = 1024 };
+
+  static void schedule();
+
+  static QVector<SmokeObject *> _queue; // NULL where removed
+  static int _size;
+  static bool _scheduled;
+  static bool _draining;
+
+  DestructionQueue() { }
+};
+
+/* Receives the queued call to drain(); QTimer::singleShot() with a
+   functor would need Qt 5.4 */
+class DestructionQueueDrainer : public QObject {
+  Q_OBJECT
+public slots:
+  void drain() { DestructionQueue::drain(); }
+};
+
+#endif
@@ -1,26 +1,132 @@
+#include <QHash>
+#include <QList>
+
 #include "DynamicBinding.hpp"
 #include "MethodCall.hpp"
 #include "Class.hpp"
+#include "RClass.hpp"
+#include "SmokeMethod.hpp"
+#include "CallProfiler.hpp"
+#include "DestructionQueue.hpp"
+
+/* A call from Smoke always has the same types, so its resolution
+   depends only on the Smoke method and the class of the target. We
+   cache that until an R method is defined (see RClass::generation()).
+   A method dropped from the cache might still be running, so it is
+   deleted only after the outermost cached call returns.
+*/
+
+struct ForeignMethodKey {
+  const Class *klass;
+  Smoke *smoke;
+  Smoke::Index method;
+
+  bool operator==(const ForeignMethodKey &other) const {
+    return klass == other.klass && smoke == other.smoke &&
+      method == other.method;
+  }
+};
+
+inline uint qHash(const ForeignMethodKey &key) {
+  return qHash(key.klass) ^ qHash(key.smoke) ^ (key.method * 31);
+}
+
+class ForeignMethodCache {
+public:
+  static Method *find(const ForeignMethodKey &key);
+  static void insert(const ForeignMethodKey &key, Method *method);
+  static inline bool idle() { return !depth; }
+  static inline void enter() { depth++; }
+  static inline void leave() {
+    if (!--depth)
+      purge();
+  }
+private:
+  static void purge();
+  static QHash<ForeignMethodKey, Method *> cache;
+  static QList<Method *> retired;
+  static unsigned int generation;
+  static int depth;
+  ForeignMethodCache() { }
+};
+
+QHash<ForeignMethodKey, Method *> ForeignMethodCache::cache;
+QList<Method *> ForeignMethodCache::retired;
+unsigned int ForeignMethodCache::generation = 0;
+int ForeignMethodCache::depth = 0;
+
+Method *ForeignMethodCache::find(const ForeignMethodKey &key) {
+  if (generation != RClass::generation()) {
+    foreach(Method *method, cache)
+      if (!method->isShared())
+        retired << method;
+    cache.clear();
+    generation = RClass::generation();
+    if (!depth)
+      purge();
+  }
+  return cache.value(key);
+}
+
+void ForeignMethodCache::insert(const ForeignMethodKey &key, Method *method) {
+  cache.insert(key, method);
+}
+
+void ForeignMethodCache::purge() {
+  qDeleteAll(retired);
+  retired.clear();
+}
+
+DynamicBinding::DynamicBinding(const SmokeMethod &method)
+  : _klass(method.klass()), _methodName(method.name()),
+    _types(method.types()), _flags(method.qualifiers()), _super(false),
+    _smoke(method.smoke()), _methodId(method.methodId())
+{ }
   
+Method *DynamicBinding::resolve(const MethodCall &call) {
+  if (!CallProfiler::enabled())
+    return call.klass()->findMethod(call);
+  qint64 start = CallProfiler::now();
+  Method *method = call.klass()->findMethod(call);
+  CallProfiler::record(call.klass(), _methodName,
+                       CallProfiler::Resolve, CallProfiler::now() - start);
+  return method;
+}
+
 SEXP DynamicBinding::invoke(SEXP obj, SEXP args) {
   SEXP ans = NULL;
+  /* Without the event loop, the queue would only grow. When no call
+     from Smoke is on the stack, no C++ frame can hold a queued object. */
+  if (DestructionQueue::isFull() && ForeignMethodCache::idle())
+    DestructionQueue::drain();
   MethodCall call(this, obj, args, _super);
-  Method *method = call.klass()->findMethod(call);
+  Method *method = resolve(call);
   if (method) {
     ans = method->invoke(obj, args);
     setLastError(method->lastError());
-    delete method;
+    if (!method->isShared())
+      delete method;
   } else setLastError(methodNotFound(call));
   return ans;
 }
 
 void DynamicBinding::invoke(SmokeObject *obj, Smoke::Stack args) {
   MethodCall call(this, obj, args, _super);
-  Method *method = call.klass()->findMethod(call);
+  bool cacheable = _smoke && !_super;
+  ForeignMethodKey key = { call.klass(), _smoke, _methodId };
+  Method *method = cacheable ? ForeignMethodCache::find(key) : NULL;
+  if (!method) {
+    method = resolve(call);
+    if (method && cacheable)
+      ForeignMethodCache::insert(key, method);
+  }
   if (method) {
+    ForeignMethodCache::enter();
     method->invoke(obj, args);
     setLastError(method->lastError());
-    delete method;
+    if (!cacheable && !method->isShared())
+      delete method;
+    ForeignMethodCache::leave();
   } else setLastError(methodNotFound(call));
 }
 
@@ -6,6 +6,7 @@
 
 class MethodSelector;
 class MethodCall;
+class SmokeMethod;
 
 /*
   DynamicBindings enable method calls between runtimes. The binding is
@@ -17,16 +18,22 @@ public:
   /* Call an object method */
   DynamicBinding(const char *methodName, bool super = false,
                  QVector<SmokeType> types = QVector<SmokeType>())
-      : _methodName(methodName), _types(types), _flags(None), _super(super) { }
+      : _methodName(methodName), _types(types), _flags(None), _super(super),
+        _smoke(NULL), _methodId(0) { }
   /* Call a static method */
   DynamicBinding(const Class *klass, const char *methodName,
                  QVector<SmokeType> types = QVector<SmokeType>())
     : _klass(klass), _methodName(methodName),
-      _types(types), _flags(Static), _super(false) { }
+      _types(types), _flags(Static), _super(false), _smoke(NULL), _methodId(0)
+  { }
   /* Obtain parameters from an existing Method */
   DynamicBinding(const Method &method)
     : _klass(method.klass()), _methodName(method.name()),
-      _types(method.types()), _flags(method.qualifiers()), _super(false) { }
+      _types(method.types()), _flags(method.qualifiers()), _super(false),
+      _smoke(NULL), _methodId(0) { }
+  /* Obtain parameters from a Smoke method, e.g., for a virtual
+     callback. Calls from Smoke are then resolved only once per class. */
+  DynamicBinding(const SmokeMethod &method);
   
   virtual void invoke(SmokeObject *obj, Smoke::Stack stack);  
   virtual SEXP invoke(SEXP obj, SEXP args);
@@ -39,16 +46,22 @@ public:
   }
   
   inline bool super() { return _super; }
-  
-private:
+
+protected:
 
   Method::ErrorType methodNotFound(const MethodCall &call);
+  /* Finds the method for the call, which is timed when profiling */
+  Method *resolve(const MethodCall &call);
   
+private:
+
   const Class *_klass;
   const char *_methodName;
   QVector<SmokeType> _types;
   Qualifiers _flags;
   bool _super;
+  Smoke *_smoke;
+  Smoke::Index _methodId;
 };
 
 #endif
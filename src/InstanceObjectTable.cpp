@@ -5,13 +5,18 @@
 #include "SmokeObject.hpp"
 #include "Class.hpp"
 #include "Property.hpp"
+#include "PreservePool.hpp"
 
 #include "wrap.hpp"
 
+static SEXP instanceTableTag() {
+  static SEXP tag = install("InstanceObjectTable");
+  return tag;
+}
+
 SmokeObject *InstanceObjectTable::instanceFromSexp(SEXP sexp) {
-  checkPointer(sexp, "InstanceObjectTable");
-  InstanceObjectTable *table =
-    static_cast<InstanceObjectTable *>(ObjectTable::fromSexp(sexp));
+  InstanceObjectTable *table = static_cast<InstanceObjectTable *>
+    (ObjectTable::fromSexp(sexp, instanceTableTag(), "InstanceObjectTable"));
   table->checkInstance();
   return table->instance();
 }
@@ -22,48 +27,70 @@ QList<QByteArray> InstanceObjectTable::sexpClasses() const {
   return classes;
 }
 
-SEXP InstanceObjectTable::methodClosure(const char *name) const {
+SEXP InstanceObjectTable::sexpTag() const {
+  return instanceTableTag();
+}
+
+/* The closures for an instance share their formals and body, and
+   find the instance as 'self' in their environment. That environment
+   is created once per table and kept alive by the table's
+   externalptr. */
+SEXP InstanceObjectTable::receiverEnv() const {
   static SEXP qtbaseNS = R_FindNamespace(mkString("qtbase"));
-  static SEXP qinvokeSym = install("qinvoke");
-  SEXP f, pf, body;
-  PROTECT(f = allocSExp(CLOSXP));
-  SET_CLOENV(f, qtbaseNS);
-  pf = allocList(1);
-  SET_FORMALS(f, pf);
-  SET_TAG(pf, R_DotsSymbol);
-  SETCAR(pf, R_MissingArg);
-  PROTECT(body =
-          lang4(qinvokeSym, _instance->sexp(), mkString(name), R_DotsSymbol));
+  static SEXP selfSym = install("self");
+  SEXP table = const_cast<InstanceObjectTable *>(this)->sexp();
+  SEXP env = R_ExternalPtrProtected(table);
+  if (env == R_NilValue) {
+    PROTECT(env = allocSExp(ENVSXP));
+    SET_ENCLOS(env, qtbaseNS);
+    SET_FRAME(env, R_NilValue);
+    defineVar(selfSym, _instance->sexp(), env);
+    R_SetExternalPtrProtected(table, env);
+    UNPROTECT(1);
+  }
+  return env;
+}
+
+static SEXP closure(SEXP formals, SEXP body, SEXP env) {
+  SEXP f = allocSExp(CLOSXP);
+  SET_FORMALS(f, formals);
   SET_BODY(f, body);
-  UNPROTECT(2);
+  SET_CLOENV(f, env);
   return f;
 }
 
+SEXP InstanceObjectTable::methodClosure(const char *name) const {
+  static SEXP formals = NULL;
+  if (!formals) { // function(...)
+    formals = allocList(1);
+    PreservePool::preserve(formals);
+    SET_TAG(formals, R_DotsSymbol);
+    SETCAR(formals, R_MissingArg);
+  }
+  SEXP body = _instance->klass()->methodClosureBody(name);
+  return closure(formals, body, receiverEnv());
+}
+
 SEXP InstanceObjectTable::superClosure() const {
-  static SEXP qtbaseNS = R_FindNamespace(mkString("qtbase"));
-  static SEXP qinvokeSym = install("qinvokeSuper");
-  SEXP f, pf, body;
-  PROTECT(f = allocSExp(CLOSXP));
-  SET_CLOENV(f, qtbaseNS);
-  pf = allocList(2);
-  SET_FORMALS(f, pf);
-  SET_TAG(pf, R_NameSymbol);
-  SETCAR(pf, R_MissingArg);
-  pf = CDR(pf);
-  SET_TAG(pf, R_DotsSymbol);
-  SETCAR(pf, R_MissingArg);
-  PROTECT(body =
-          lang4(qinvokeSym, _instance->sexp(), R_NameSymbol, R_DotsSymbol));
-  SET_BODY(f, body);
-  UNPROTECT(2);
-  return f;
+  static SEXP formals = NULL, body = NULL;
+  if (!formals) { // function(name, ...) qinvokeSuper(self, name, ...)
+    formals = allocList(2);
+    PreservePool::preserve(formals);
+    SET_TAG(formals, R_NameSymbol);
+    SETCAR(formals, R_MissingArg);
+    SET_TAG(CDR(formals), R_DotsSymbol);
+    SETCAR(CDR(formals), R_MissingArg);
+    body = lang4(install("qinvokeSuper"), install("self"), R_NameSymbol,
+                 R_DotsSymbol);
+    PreservePool::preserve(body);
+  }
+  return closure(formals, body, receiverEnv());
 }
 
-bool InstanceObjectTable::methodExists(const char *name) const {
-  Method::Qualifiers qual = Method::None;
-  if (!_internal)
-    qual |= Method::Public | Method::NotStatic;
-  return _instance->klass()->hasMethod(name, qual);
+bool InstanceObjectTable::methodExists(int kinds) const {
+  if (_internal)
+    return kinds & Class::MethodMember;
+  return kinds & Class::PublicMethodMember;
 }
 
 Rboolean
@@ -71,47 +98,31 @@ InstanceObjectTable::exists(const char * name, Rboolean *canCache) const {
   bool found = FALSE;
   checkInstance();
   if (canCache) *canCache = TRUE;
+  int kinds = _instance->klass()->memberKinds(name);
   if (_internal)
     found = !qstrcmp(name, "this") ||
       findVarInFrame(fieldEnv(), install(name)) != R_UnboundValue ||
-      enumValue(name) != R_UnboundValue;
+      kinds & Class::EnumMember;
   if (!found)
-    found = methodExists(name);
-  if (!found) {
-    Property *prop = _instance->klass()->property(name);
-    if (prop) {
-      found = true;
-      delete prop;
-    }
-  }
+    found = methodExists(kinds) || kinds & Class::PropertyMember;
   return (Rboolean)found;
 }
 
-SEXP InstanceObjectTable::enumValue(const char *name) const {
-  SEXP ans = R_UnboundValue;
-  int val = _instance->klass()->enumValues().value(name, NA_INTEGER);
-  if (val != NA_INTEGER) {
-    PROTECT(ans = ScalarInteger(val));
-    setAttrib(ans, R_ClassSymbol, mkString("QtEnum"));
-    UNPROTECT(1);
-  }
-  return ans;
-}
-   
 SEXP InstanceObjectTable::get(const char * name, Rboolean* canCache) const {
   SEXP ans = R_UnboundValue;
   checkInstance();
   if (canCache) *canCache = TRUE;
+  int kinds = _instance->klass()->memberKinds(name);
   if (_internal) {
     if (!qstrcmp(name, "this"))
       ans = _instance->internalSexp(R_EmptyEnv);
     else if (!qstrcmp(name, "super"))
       ans = superClosure();
     else ans = findVarInFrame(fieldEnv(), install(name));
-    if (ans == R_UnboundValue)
-      ans = enumValue(name);
+    if (ans == R_UnboundValue && kinds & Class::EnumMember)
+      ans = _instance->klass()->enumValue(name);
   }
-  if (ans == R_UnboundValue) {
+  if (ans == R_UnboundValue && kinds & Class::PropertyMember) {
     Property *prop = _instance->klass()->property(name);
     if (prop) { // FIXME: throw error if not readable?
       if (prop->isReadable())
@@ -119,7 +130,7 @@ SEXP InstanceObjectTable::get(const char * name, Rboolean* canCache) const {
       delete prop;
     }
   }
-  if (ans == R_UnboundValue && methodExists(name))
+  if (ans == R_UnboundValue && methodExists(kinds))
     ans = methodClosure(name); // make a wrapper for method
   
   return ans;
@@ -36,15 +36,16 @@ public:
 
 protected:
   virtual QList<QByteArray> sexpClasses() const;
+  virtual SEXP sexpTag() const;
   
 private:
 
   SEXP methodClosure(const char *name) const;
-  SEXP enumValue(const char *name) const;
   SEXP fieldEnv() const;
   void checkInstance() const;
-  bool methodExists(const char *name) const;
+  bool methodExists(int kinds) const;
   SEXP superClosure() const;
+  SEXP receiverEnv() const;
   
   SmokeObject *_instance;
   bool _internal;
@@ -43,6 +43,10 @@ public:
   virtual QVector<SmokeType> types() const = 0;
   virtual const Class* klass() const = 0;
   virtual Qualifiers qualifiers() const = 0;
+
+  /* Methods returned by Class::findMethod() belong to the caller,
+     unless they are shared, like the SmokeMethod flyweights. */
+  virtual bool isShared() const { return false; }
   
   virtual void invoke(SmokeObject *obj, Smoke::Stack stack) = 0;  
   virtual SEXP invoke(SEXP obj, SEXP args) = 0;
@@ -2,42 +2,63 @@
 #include "RMethod.hpp"
 #include "SmokeMethod.hpp"
 #include "SmokeObject.hpp"
+#include "SmokeModule.hpp"
 #include "TypeHandler.hpp"
+#include "CallProfiler.hpp"
+#include "convert.hpp"
 
 #include <Rinternals.h>
 
 MethodCall::MethodCall(Method *method, SEXP obj, SEXP args, bool super)
   : _cur(0), _called(false), _mode(Identity), _super(super),
     _target(obj ? SmokeObject::fromSexp(obj) : NULL), _stack(NULL),
-    _args(args), _ret(R_NilValue), _method(method), _types(method->types())
+    _args(args), _ret(R_NilValue), _method(method), _types(method->types()),
+    _marshalFns(NULL),
+    _invokeStart(0), _invokeEnd(0), _returnEnd(0)
 { }
 MethodCall::MethodCall(Method *method, SmokeObject *obj, Smoke::Stack args,
                        bool super)
   : _cur(0), _called(false), _mode(Identity), _super(super),
     _target(obj), _stack(args), _args(NULL), _ret(R_NilValue),
-    _method(method), _types(method->types())
+    _method(method), _types(method->types()), _marshalFns(NULL),
+    _invokeStart(0), _invokeEnd(0), _returnEnd(0)
 { }
 MethodCall::MethodCall(RMethod *method, SEXP obj, SEXP args, bool super)
   : _cur(0), _called(false), _mode(Identity), _super(super),
     _target(obj ? SmokeObject::fromSexp(obj) : NULL), _stack(NULL),
-    _args(args), _ret(R_NilValue), _method(method), _types(method->types())
+    _args(args), _ret(R_NilValue), _method(method), _types(method->types()),
+    _marshalFns(NULL),
+    _invokeStart(0), _invokeEnd(0), _returnEnd(0)
 { } 
 MethodCall::MethodCall(ForeignMethod *method, SEXP obj, SEXP args, bool super)
   : _cur(0), _called(false), _mode(RToSmoke), _super(super),
     _target(obj ? SmokeObject::fromSexp(obj) : NULL), _stack(NULL),
-    _args(args), _ret(R_NilValue), _method(method), _types(method->types())
+    _args(args), _ret(R_NilValue), _method(method), _types(method->types()),
+    _marshalFns(NULL),
+    _invokeStart(0), _invokeEnd(0), _returnEnd(0)
 { }
 MethodCall::MethodCall(RMethod *method, SmokeObject *obj, Smoke::Stack args,
                        bool super)
   : _cur(0), _called(false), _mode(SmokeToR), _super(super),
     _target(obj), _stack(args), _args(NULL), _ret(R_NilValue), 
-    _method(method), _types(method->types())
+    _method(method), _types(method->types()), _marshalFns(NULL),
+    _invokeStart(0), _invokeEnd(0), _returnEnd(0)
 { }
 MethodCall::MethodCall(ForeignMethod *method, SmokeObject *obj,
                        Smoke::Stack args, bool super)
   : _cur(0), _called(false), _mode(Identity), _super(super),
     _target(obj), _stack(args), _args(NULL), _ret(R_NilValue),
-    _method(method), _types(method->types())
+    _method(method), _types(method->types()), _marshalFns(NULL),
+    _invokeStart(0), _invokeEnd(0), _returnEnd(0)
+{ }
+MethodCall::MethodCall(ForeignMethod *method, SEXP obj, SEXP args,
+                       const QVector<SmokeType> &types,
+                       const TypeHandler::MarshalFn *marshalFns)
+  : _cur(0), _called(false), _mode(RToSmoke), _super(false),
+    _target(obj ? SmokeObject::fromSexp(obj) : NULL), _stack(NULL),
+    _args(args), _ret(R_NilValue), _method(method), _types(types),
+    _marshalFns(marshalFns),
+    _invokeStart(0), _invokeEnd(0), _returnEnd(0)
 { }
 
 /* These two are in cpp, because we do not want Rinternals.h in header */
@@ -79,14 +100,21 @@ void MethodCall::marshal() {
   }
 
   if (!_called) {
+    bool profiling = CallProfiler::enabled();
     _called = true;
     _cur = 0;
+    if (profiling)
+      _invokeStart = CallProfiler::now();
     invokeMethod();
+    if (profiling)
+      _invokeEnd = CallProfiler::now();
     if (_method->lastError() == Method::NoError) {
       flip();
       marshalItem();
       flip();
     }
+    if (profiling)
+      _returnEnd = CallProfiler::now();
   }
 
   _cur = oldcur;
@@ -109,21 +137,40 @@ void MethodCall::invokeMethod() {
 #undef eval
 
 void MethodCall::eval() {
-  if (_mode == RToSmoke) 
-    _stack = new Smoke::StackItem[length(_args) + 1];
-  else if (_mode == SmokeToR)
+  bool profiling = CallProfiler::enabled() && _mode != Identity;
+  qint64 start = profiling ? CallProfiler::now() : 0;
+  if (_mode == RToSmoke) {
+    _stackItems.resize(length(_args) + 1);
+    _stack = _stackItems.data();
+  } else if (_mode == SmokeToR)
     PROTECT(_args = allocVector(VECSXP, stackSize() - 1));
   if (_mode != Identity) {
     marshal();
     _called = false;
   } else invokeMethod();
-  if (_mode == RToSmoke) {
-    delete[] _stack;
+  if (_mode == RToSmoke)
     _stack = NULL;
-  } else if (_mode == SmokeToR) {
+  else if (_mode == SmokeToR) {
     UNPROTECT(1);
     _args = NULL;
   }
+  if (profiling)
+    recordProfile(start);
+}
+
+/* Whatever is not invoking or returning is marshalling the arguments
+   (including any cleanup afterwards). */
+void MethodCall::recordProfile(qint64 start) {
+  qint64 total = CallProfiler::now() - start;
+  qint64 invoke = _invokeEnd - _invokeStart;
+  qint64 unmarshal = _returnEnd - _invokeEnd;
+  const Class *klass = this->klass();
+  const char *methodName = _method->name();
+  CallProfiler::record(klass, methodName, CallProfiler::Marshal,
+                       total - invoke - unmarshal);
+  CallProfiler::record(klass, methodName, CallProfiler::Invoke, invoke);
+  CallProfiler::record(klass, methodName, CallProfiler::Unmarshal,
+                       unmarshal);
 }
 
 /* Static MethodCall functions (TypeHandler registry) */
@@ -135,6 +182,7 @@ void MethodCall::registerTypeHandlers(TypeHandler *handlers) {
     typeHandlers.insert(handlers->name, handlers);
     handlers++;
   }
+  SmokeModule::indexAllTypeHandlers();
 }
 
 
@@ -152,18 +200,26 @@ static TypeHandler unknownHandler =
 static TypeHandler voidHandler =
   { "void", marshal_void, NULL };
 
-TypeHandler *MethodCall::typeHandler(const SmokeType &type) {
+/* Looks up the handler by name; see typeHandler() for the fast path */
+TypeHandler *MethodCall::findTypeHandler(const SmokeType &type) {
   TypeHandler *h = NULL;
   if (type.elem())
     h = &baseHandler;
   else if (!type.name())
     h = &voidHandler;
-  else h = typeHandlers[type.name()];
+  else h = typeHandlers.value(type.name());
   if (!h)
     h = &unknownHandler;
   return h;
 }
 
+TypeHandler *MethodCall::typeHandler(const SmokeType &type) {
+  SmokeModule *module = SmokeModule::module(type.smoke());
+  if (module)
+    return module->typeHandler(type.typeId());
+  return findTypeHandler(type);
+}
+
 TypeHandler::MarshalFn MethodCall::marshalFn(const SmokeType &type) {
   return typeHandler(type)->marshalFn;
 }
@@ -180,48 +236,54 @@ TypeHandler::ScoreArgFn MethodCall::scoreArgFn(const SmokeType &type) {
   return typeHandler(type)->scoreArgFn;
 }
 
-/* Cache key generation */
-
-QByteArray
-MethodCall::argKey(SEXP arg) const
-{
-  const char * className = CHAR(asChar(getAttrib(arg, R_ClassSymbol)));
-  const char *r = "";
-  if (arg == R_NilValue)
-    r = "u";
-  else if (TYPEOF(arg) == INTSXP) {
-    if (inherits(arg, "QtEnum"))
-      r = className;
-    else r = "i";
-  } else if (TYPEOF(arg) == REALSXP)
-    r = "n";
-  else if (TYPEOF(arg) == STRSXP)
-    r = "s";
-  else if(TYPEOF(arg) == LGLSXP)
-    r = "B";
-  else if (TYPEOF(arg) == ENVSXP) {
-    SmokeObject *o = SmokeObject::fromSexp(arg);
-    if (o == 0 || o->smoke() == 0) {
-      r = "a";
-    } else {
-      r = o->smoke()->classes[o->classId()].className;
-    }
-  } else {
-    r = "U";
+/* Argument tags for caching */
+
+/* An object argument is tagged by its Class, which is sufficient for
+   scoring; an environment without an instance falls back to its R
+   type, like any other value. The Class pointers are aligned, so the
+   tags for everything else have the lowest bit set. Those record the
+   R type, along with the few properties that influence munging and
+   scoring: whether an atomic vector is a scalar, whether an integer
+   is a QtEnum and whether a string is a single character. An unboxed
+   value also records its type.
+*/
+enum {
+  ARG_TAG_SCALAR = 1 << 0,
+  ARG_TAG_ENUM = 1 << 1,
+  ARG_TAG_CHAR = 1 << 2,
+  ARG_TAG_SHIFT = 3,
+  ARG_TAG_UNBOXED_SHIFT = ARG_TAG_SHIFT + 5 // R types fit in 5 bits
+};
+
+quintptr MethodCall::argTag(SEXP arg) {
+  int rtype = TYPEOF(arg);
+  if (rtype == ENVSXP || SmokeObject::isHandle(arg)) {
+    SmokeObject *so = SmokeObject::fromSexp(arg);
+    if (so)
+      return reinterpret_cast<quintptr>(so->klass());
   }
-  return QByteArray(r);
-}
-
-// FIXME: this only works from R. Could generalize, but not sure if
-// this caching is worth it yet.
-QByteArray
-MethodCall::cacheKey() const {
-  QByteArray mcid(klass()->name());
-  mcid += ';';
-  mcid += _method->name();
-  for(int i = 0; i < length(_args); i++) {
-    mcid += ';';
-    mcid += argKey(VECTOR_ELT(_args, i));
+  quintptr tag = rtype << ARG_TAG_SHIFT;
+  if (isVectorAtomic(arg) && length(arg) == 1)
+    tag |= ARG_TAG_SCALAR;
+  if (rtype == INTSXP && OBJECT(arg) && inherits(arg, "QtEnum"))
+    tag |= ARG_TAG_ENUM;
+  else if (rtype != STRSXP && OBJECT(arg) && isVectorAtomic(arg))
+    tag |= unboxedType(arg) << ARG_TAG_UNBOXED_SHIFT;
+  if (rtype == STRSXP && length(arg) &&
+      strlen(CHAR(STRING_ELT(arg, 0))) == 1)
+    tag |= ARG_TAG_CHAR;
+  return (tag << 1) | 1;
+}
+
+/* A call from Smoke is tagged by its argument types, instead. Those
+   are pointers to Smoke metadata, so they never collide with the tags
+   above. */
+void MethodCall::argTags(ArgTags &tags) const {
+  int n = qMax(numArgs(), 0);
+  tags.resize(n);
+  for (int i = 0; i < n; i++) {
+    if (_args)
+      tags[i] = argTag(VECTOR_ELT(_args, i));
+    else tags[i] = reinterpret_cast<quintptr>(&_types[i+1].type());
   }
-  return mcid;
 }
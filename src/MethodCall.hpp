@@ -2,6 +2,7 @@
 #define METHOD_CALL_H
 
 #include <QVector>
+#include <QVarLengthArray>
 #include <QHash>
 
 #include <smoke.h>
@@ -39,6 +40,10 @@ public:
              bool super = false);
   MethodCall(ForeignMethod *method, SmokeObject *obj, Smoke::Stack args,
              bool super = false);
+  /* With the types and marshalling functions already looked up */
+  MethodCall(ForeignMethod *method, SEXP obj, SEXP args,
+             const QVector<SmokeType> &types,
+             const TypeHandler::MarshalFn *marshalFns);
   
   /* General Accessors */
   
@@ -108,24 +113,29 @@ public:
   /* Utilities */
   
   void unsupported();
-  QByteArray cacheKey() const;
+
+  /* Compact description of the argument types, used to key caches
+     of resolved overloads. Building it does not allocate, unless
+     there are many arguments. */
+  typedef QVarLengthArray<quintptr, 8> ArgTags;
+  void argTags(ArgTags &tags) const;
+  static quintptr argTag(SEXP arg);
 
   /* TypeHandler registration and utilities */
   
   static void registerTypeHandlers(TypeHandler *handlers);
+  static TypeHandler *findTypeHandler(const SmokeType &type);
+  static TypeHandler::MarshalFn marshalFn(const SmokeType &type);
   static int scoreArg(SEXP arg, Smoke *smoke, Smoke::Index type);
   static int scoreArg(SEXP arg, const SmokeType &type);
 
 private:
 
   static QHash<QByteArray, TypeHandler *> typeHandlers;
-  static TypeHandler::MarshalFn marshalFn(const SmokeType &type);
   static TypeHandler::ScoreArgFn scoreArgFn(const SmokeType &type);
 
   static TypeHandler *typeHandler(const SmokeType &type);
   
-  QByteArray argKey(SEXP arg) const;
-  
   inline void flip() {
     if (_mode == RToSmoke)
       _mode = SmokeToR;
@@ -134,11 +144,13 @@ private:
   }
 
   inline void marshalItem() {
-    TypeHandler::MarshalFn fn = marshalFn(type());
+    TypeHandler::MarshalFn fn =
+      _marshalFns ? _marshalFns[_cur] : marshalFn(type());
     (*fn)(this);
   }
   
   void invokeMethod();
+  void recordProfile(qint64 start);
   
   int _cur;
   bool _called;
@@ -150,6 +162,12 @@ private:
   SEXP _ret;
   Method* _method;
   QVector<SmokeType> _types;
+  /* Storage for '_stack' when marshalling from R; spills to the heap
+     only for calls with more than 8 arguments */
+  QVarLengthArray<Smoke::StackItem, 9> _stackItems;
+  const TypeHandler::MarshalFn *_marshalFns;
+  /* Timestamps, only when profiling */
+  qint64 _invokeStart, _invokeEnd, _returnEnd;
 };
 
 #endif
@@ -69,9 +69,8 @@ const Class *MocClass::findDelegateClass() const {
   const QMetaObject *meta = _meta;
   const Class *delegate = NULL;
   do {
-    Smoke::ClassMap::iterator i = Smoke::classMap.find(meta->className());
-    if (i != Smoke::classMap.end()) {
-      Smoke *smoke = i->second.smoke;
+    Smoke *smoke = Smoke::findClass(meta->className()).smoke;
+    if (smoke) {
       delegate = Class::fromSmokeId(smoke,
                                     smoke->idClass(meta->className()).index);
     } else {
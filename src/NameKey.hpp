@@ -0,0 +1,43 @@
+#ifndef NAME_KEY_H
+#define NAME_KEY_H
+
+#include <QByteArray>
+
+/* A borrowed C string that can serve as a QHash key. This lets us
+   probe a hash directly with the 'const char *' we get from R or
+   Smoke, instead of first building a QByteArray (which allocates).
+   Keys stored in a hash must point to memory that outlives the hash,
+   like the Smoke metadata or an interned copy.
+*/
+class NameKey {
+public:
+  NameKey(const char *name = NULL) : _name(name), _hash(hashName(name)) { }
+
+  inline const char *name() const { return _name; }
+  inline uint hash() const { return _hash; }
+
+  inline bool operator==(const NameKey &other) const {
+    return _hash == other._hash && qstrcmp(_name, other._name) == 0;
+  }
+  inline bool operator!=(const NameKey &other) const {
+    return !(*this == other);
+  }
+
+  /* FNV-1a: short names dominate, so keep it simple */
+  static inline uint hashName(const char *name) {
+    uint h = 2166136261u;
+    if (name) {
+      for (; *name; name++)
+        h = (h ^ (uchar)*name) * 16777619u;
+    }
+    return h;
+  }
+
+private:
+  const char *_name;
+  uint _hash;
+};
+
+inline uint qHash(const NameKey &key) { return key.hash(); }
+
+#endif
@@ -7,6 +7,8 @@
 
 #define THIS (reinterpret_cast<ObjectTable *>(tb->privateData))
 
+int ObjectTable::_count = 0;
+
 static void finalizeObjectTable(SEXP obj) {
   delete ObjectTable::fromSexp(obj);
 }
@@ -42,8 +44,20 @@ ObjectTable_objects(R_ObjectTable *tb)
   return THIS->objects();
 }
 
+static SEXP objectTableTag() {
+  static SEXP tag = install("ObjectTable");
+  return tag;
+}
+
 ObjectTable *ObjectTable::fromSexp(SEXP sexp) {
-  R_ObjectTable *tb = unwrapPointerSep(sexp, ObjectTable, R_ObjectTable);
+  return fromSexp(sexp, objectTableTag(), "ObjectTable");
+}
+
+ObjectTable *ObjectTable::fromSexp(SEXP sexp, SEXP tag, const char *className)
+{
+  checkPointerTag(sexp, tag, className);
+  R_ObjectTable *tb =
+    reinterpret_cast<R_ObjectTable *>(R_ExternalPtrAddr(sexp));
   return THIS;
 }
 
@@ -71,7 +85,9 @@ SEXP ObjectTable::createSexp() {
   tb->onAttach = NULL;
   tb->onDetach = NULL;
 
-  return wrapPointer(tb, sexpClasses(), finalizeObjectTable);
+  SEXP ans = wrapPointer(tb, sexpClasses(), finalizeObjectTable);
+  R_SetExternalPtrTag(ans, sexpTag());
+  return ans;
 }
 
 QList<QByteArray> ObjectTable::sexpClasses() const {
@@ -81,10 +97,15 @@ QList<QByteArray> ObjectTable::sexpClasses() const {
   return classes;
 }
 
+SEXP ObjectTable::sexpTag() const {
+  return objectTableTag();
+}
+
 ObjectTable::~ObjectTable() {
   SEXP extptr = sexp();
   R_ObjectTable *tb =
     reinterpret_cast<R_ObjectTable *>(R_ExternalPtrAddr(extptr));
   delete tb;
   R_ClearExternalPtr(extptr);
+  _count--;
 }
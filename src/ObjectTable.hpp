@@ -10,7 +10,7 @@ typedef struct SEXPREC* SEXP;
 class ObjectTable {
 public:
 
-  ObjectTable() : _sexp(NULL) { }
+  ObjectTable() : _sexp(NULL) { _count++; }
   
   virtual ~ObjectTable();
   
@@ -25,12 +25,21 @@ public:
 
   static ObjectTable * fromSexp(SEXP sexp); // unwrap
 
+  /* live tables, including those orphaned by their instance */
+  static inline int count() { return _count; }
+
 protected:
+  /* unwrap, checking 'tag' before the class attribute */
+  static ObjectTable * fromSexp(SEXP sexp, SEXP tag, const char *className);
+  
   virtual QList<QByteArray> sexpClasses() const;
+  /* identity tag of the externalptr */
+  virtual SEXP sexpTag() const;
 
 private:
   SEXP createSexp();
   SEXP _sexp;
+  static int _count;
 };
 
 #endif
@@ -0,0 +1,131 @@
+#ifndef POINTER_TABLE_H
+#define POINTER_TABLE_H
+
+#include <QtGlobal>
+
+/* Maps pointers to pointers, with open addressing and linear probing.
+   The key and value share a slot, so a lookup usually touches a
+   single cache line, whereas QHash chases a pointer per node. Removal
+   shifts the following entries back, so there are no tombstones. The
+   NULL key marks an empty slot and cannot be stored.
+
+   The table counts its lookups and probes, for diagnostics.
+*/
+template<typename T>
+class PointerTable {
+public:
+  PointerTable()
+    : _slots(NULL), _mask(0), _size(0), _lookups(0), _probes(0),
+      _maxProbes(0) { }
+  ~PointerTable() { delete[] _slots; }
+
+  inline T *value(const void *key) const {
+    _lookups++;
+    if (!_slots)
+      return NULL;
+    uint probes = 1;
+    for (uint i = index(key); _slots[i].key; i = (i + 1) & _mask, probes++) {
+      if (_slots[i].key == key) {
+        countProbes(probes);
+        return _slots[i].value;
+      }
+    }
+    countProbes(probes);
+    return NULL;
+  }
+  inline bool contains(const void *key) const { return value(key) != NULL; }
+
+  void insert(const void *key, T *value) {
+    if ((_size + 1) * 10 > capacity() * 7)
+      grow();
+    uint i = index(key);
+    while (_slots[i].key && _slots[i].key != key)
+      i = (i + 1) & _mask;
+    if (!_slots[i].key)
+      _size++;
+    _slots[i].key = key;
+    _slots[i].value = value;
+  }
+
+  void remove(const void *key) {
+    if (!_slots)
+      return;
+    uint i = index(key);
+    while (_slots[i].key != key) {
+      if (!_slots[i].key)
+        return;
+      i = (i + 1) & _mask;
+    }
+    // shift back the entries that probed past the hole
+    for (uint j = (i + 1) & _mask; _slots[j].key; j = (j + 1) & _mask) {
+      uint home = index(_slots[j].key);
+      if (((j - home) & _mask) >= ((j - i) & _mask)) {
+        _slots[i] = _slots[j];
+        i = j;
+      }
+    }
+    _slots[i].key = NULL;
+    _slots[i].value = NULL;
+    _size--;
+  }
+
+  /* For iterating over the slots, which may be empty (NULL) */
+  inline T *valueAt(int slot) const { return _slots[slot].value; }
+
+  inline int size() const { return _size; }
+  inline int capacity() const { return _slots ? _mask + 1 : 0; }
+  inline double loadFactor() const {
+    return _slots ? (double)_size / capacity() : 0;
+  }
+  inline double lookups() const { return _lookups; }
+  inline double meanProbes() const {
+    return _lookups ? _probes / _lookups : 0;
+  }
+  inline uint maxProbes() const { return _maxProbes; }
+
+private:
+  struct Slot {
+    const void *key;
+    T *value;
+  };
+
+  enum { InitialCapacity = 1024 };
+
+  /* Pointers are aligned and often allocated in sequence, so mix all
+     of the bits (the finalizer of MurmurHash3) */
+  inline uint index(const void *key) const {
+    quint64 h = reinterpret_cast<quintptr>(key);
+    h ^= h >> 33;
+    h *= Q_UINT64_C(0xff51afd7ed558ccd);
+    h ^= h >> 33;
+    return uint(h) & _mask;
+  }
+
+  inline void countProbes(uint probes) const {
+    _probes += probes;
+    if (probes > _maxProbes)
+      _maxProbes = probes;
+  }
+
+  void grow() {
+    Slot *old = _slots;
+    int oldCapacity = capacity();
+    int newCapacity = old ? oldCapacity * 2 : (int)InitialCapacity;
+    _slots = new Slot[newCapacity]();
+    _mask = newCapacity - 1;
+    _size = 0;
+    for (int i = 0; i < oldCapacity; i++)
+      if (old[i].key)
+        insert(old[i].key, old[i].value);
+    delete[] old;
+  }
+
+  Slot *_slots;
+  uint _mask;
+  int _size;
+  mutable double _lookups;
+  mutable double _probes;
+  mutable uint _maxProbes;
+};
+
+#endif
@@ -0,0 +1,55 @@
+#include "PreservePool.hpp"
+
+#include <Rinternals.h>
+
+SEXP PreservePool::_pool = NULL;
+QHash<SEXP, int> PreservePool::_slots;
+QVector<int> PreservePool::_counts;
+QVector<int> PreservePool::_free;
+
+void PreservePool::preserve(SEXP x) {
+  QHash<SEXP, int>::const_iterator it = _slots.constFind(x);
+  if (it != _slots.constEnd()) {
+    _counts[it.value()]++;
+    return;
+  }
+  if (_free.isEmpty()) { // x is often fresh, and growing allocates
+    PROTECT(x);
+    grow();
+    UNPROTECT(1);
+  }
+  int slot = _free.last();
+  _free.removeLast();
+  SET_VECTOR_ELT(_pool, slot, x);
+  _counts[slot] = 1;
+  _slots.insert(x, slot);
+}
+
+void PreservePool::release(SEXP x) {
+  QHash<SEXP, int>::iterator it = _slots.find(x);
+  if (it == _slots.end())
+    return;
+  int slot = it.value();
+  if (--_counts[slot] == 0) {
+    SET_VECTOR_ELT(_pool, slot, R_NilValue);
+    _free.append(slot);
+    _slots.erase(it);
+  }
+}
+
+/* Doubles the pool. This is the only time the pool calls
+   R_ReleaseObject(), and the precious list is short. */
+void PreservePool::grow() {
+  int oldCapacity = capacity();
+  int newCapacity = oldCapacity ? oldCapacity * 2 : 1024;
+  SEXP pool = allocVector(VECSXP, newCapacity);
+  R_PreserveObject(pool);
+  for (int i = 0; i < oldCapacity; i++)
+    SET_VECTOR_ELT(pool, i, VECTOR_ELT(_pool, i));
+  if (_pool)
+    R_ReleaseObject(_pool);
+  _pool = pool;
+  _counts.resize(newCapacity);
+  for (int i = newCapacity - 1; i >= oldCapacity; i--)
+    _free.append(i);
+}
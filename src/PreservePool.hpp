@@ -0,0 +1,36 @@
+#ifndef PRESERVE_POOL_H
+#define PRESERVE_POOL_H
+
+#include <QHash>
+#include <QVector>
+
+typedef struct SEXPREC* SEXP;
+
+/* Protects SEXPs held by C++ objects from the garbage collector, like
+   R_PreserveObject(). R keeps its preserved objects in a list, so
+   R_ReleaseObject() scans the list, and releasing n objects takes
+   quadratic time. The pool keeps them in the slots of a single
+   preserved list (VECSXP) and finds the slot through a hash, so both
+   operations take constant time. Like R, the pool counts repeated
+   preservations of the same object.
+*/
+class PreservePool {
+public:
+  static void preserve(SEXP x);
+  static void release(SEXP x);
+
+  static inline int size() { return _slots.size(); }
+  static inline int capacity() { return _counts.size(); }
+
+private:
+  static void grow();
+
+  static SEXP _pool;
+  static QHash<SEXP, int> _slots;
+  static QVector<int> _counts; // by slot, zero if free
+  static QVector<int> _free;
+
+  PreservePool() { }
+};
+
+#endif
@@ -3,15 +3,28 @@
 #include "RProperty.hpp"
 #include "MethodCall.hpp"
 #include "SmokeClass.hpp"
+#include "SmokeModule.hpp"
+#include "PreservePool.hpp"
 
 #include <Rinternals.h>
 
+unsigned int RClass::_generation = 0;
+
 RClass::RClass(SEXP klass) : _klass(klass) {
-  R_PreserveObject(klass);
+  PreservePool::preserve(klass);
+  SEXP names = PROTECT(R_lsInternal(methodEnv(), (Rboolean)true));
+  for (int i = 0; i < length(names); i++)
+    methodChanged(CHAR(STRING_ELT(names, i)));
+  UNPROTECT(1);
+}
+
+void RClass::methodChanged(const char *name) {
+  _generation++;
+  SmokeModule::setOverridden(name);
 }
 
 RClass::~RClass() {
-  R_ReleaseObject(_klass);
+  PreservePool::release(_klass);
 }
 
 const char *RClass::name() const {
@@ -31,8 +31,17 @@ public:
   inline SEXP sexp() const { return _klass; }
   inline bool isNull() const { return _klass == NULL; }
 
+  /* Called when a method is defined on an R class. This bumps the
+     generation, which invalidates cached method lookups. */
+  static void methodChanged(const char *name);
+  /* Called when another member, like a property, is defined */
+  static inline void classChanged() { _generation++; }
+  static inline unsigned int generation() { return _generation; }
+  
 private:
 
+  static unsigned int _generation;
+
   const Class* parent() const; // support only single inheritance
   SEXP metadata() const;
   SEXP properties() const;
@@ -3,6 +3,7 @@
 #include "SmokeStack.hpp"
 #include "RMethod.hpp"
 #include "SmokeType.hpp"
+#include "PreservePool.hpp"
 
 #include <Rinternals.h>
 
@@ -11,14 +12,14 @@ RDynamicQObject::RDynamicQObject(const MocMethod &method, SEXP function,
   : DynamicQObject(sender), _method(method), _function(function),
     _userData(userData)
 {
-  R_PreserveObject(function);
+  PreservePool::preserve(function);
   if (userData)
-    R_PreserveObject(userData);
+    PreservePool::preserve(userData);
 }
 RDynamicQObject::~RDynamicQObject() {
-  R_ReleaseObject(_function);
+  PreservePool::release(_function);
   if (_userData)
-    R_ReleaseObject(_userData);
+    PreservePool::release(_userData);
 }
 
 DynamicSlot *RDynamicQObject::createSlot(const char *slot) {
@@ -12,7 +12,7 @@ SEXP RMethod::invoke(SEXP self, SEXP args) {
   
   if (self) {
     SmokeObject *so = SmokeObject::fromSexp(self);
-    fun = so->enclose(_closure);
+    fun = so->enclosure(_closure);
   } else fun = _closure;
   SETCAR(lang, fun);
   
@@ -3,6 +3,8 @@
 #include "Class.hpp"
 #include "DynamicBinding.hpp"
 #include "SmokeMethod.hpp"
+#include "SmokeModule.hpp"
+#include "RClass.hpp"
 
 #include <Rinternals.h>
 
@@ -41,9 +43,42 @@ void RSmokeBinding::deleted(Smoke::Index classId, void *obj) {
   delete o;
 }
 
+/* We look for an R implementation in the R classes between the
+   object class and its Smoke base. */
+RSmokeBinding::Implementor
+RSmokeBinding::findImplementor(const Class *klass, Smoke::Index method) {
+  if (_generation != RClass::generation()) {
+    _implementors.clear();
+    _generation = RClass::generation();
+  }
+  QPair<const Class *, Smoke::Index> key(klass, method);
+  QHash<QPair<const Class *, Smoke::Index>, Implementor>::const_iterator it =
+    _implementors.constFind(key);
+  if (it != _implementors.constEnd())
+    return it.value();
+  
+  const char *methodName = smoke->methodNames[smoke->methods[method].name];
+  const Class *c = klass;
+  bool impl = false;
+  QList<const Class *> p = c->parents();
+  while(p.size() == 1 && c->smokeBase() == p[0]->smokeBase() && !impl) {
+    impl = c->implementsMethod(methodName);
+    c = p[0];
+    p = c->parents();
+  }
+  Implementor implementor = { c, impl };
+  _implementors.insert(key, implementor);
+  return implementor;
+}
+
 bool RSmokeBinding::callMethod(Smoke::Index method, void *obj,
                                Smoke::Stack args, bool isAbstract)
 {
+  /* Usually, no R class has a method of this name, so we are done */
+  Smoke::Index nameId = smoke->methods[method].name;
+  if (!isAbstract && !SmokeModule::module(smoke)->isOverridden(nameId))
+    return false;
+  
   SmokeObject *o =
     SmokeObject::fromPtr(obj, smoke, smoke->methods[method].classId);
 
@@ -64,18 +99,12 @@ bool RSmokeBinding::callMethod(Smoke::Index method, void *obj,
            (const char *) signature);
 #endif
 
-  const char *methodName = smoke->methodNames[smoke->methods[method].name];
+  const char *methodName = smoke->methodNames[nameId];
   
-  const Class *c = o->klass();
+  Implementor implementor = findImplementor(o->klass(), method);
+  const Class *c = implementor.klass;
   bool success = false;
-  bool impl = false;
-  QList<const Class *> p = c->parents();
-  while(p.size() == 1 && c->smokeBase() == p[0]->smokeBase() && !impl) {
-    impl = c->implementsMethod(methodName);
-    c = p[0];
-    p = c->parents();
-  }
-  if (impl) {
+  if (implementor.implemented) {
     //qDebug("user implements: %s", methodName);
     DynamicBinding binding(SmokeMethod(smoke, method));
     binding.invoke(o, args);
@@ -1,6 +1,9 @@
 #ifndef R_SMOKE_BINDING_H
 #define R_SMOKE_BINDING_H
 
+#include <QHash>
+#include <QPair>
+
 #include <smoke.h>
 #include <qt_smoke.h>
 
@@ -10,13 +13,14 @@
  */
 
 class SmokeObject;
+class Class;
 
 typedef struct SEXPREC* SEXP;
 
 class RSmokeBinding : public SmokeBinding
 {
 public:
-  RSmokeBinding(Smoke *s) : SmokeBinding(s) {}
+  RSmokeBinding(Smoke *s) : SmokeBinding(s), _generation(0) {}
  
   void deleted(Smoke::Index classId, void *obj); 
   bool callMethod(Smoke::Index method, void *obj,
@@ -24,6 +28,19 @@ public:
   char *className(Smoke::Index classId);
 
   Smoke *getSmoke() { return smoke; }
+
+private:
+
+  /* Where the search for an R implementation of a virtual stopped,
+     and whether it found one, by object class and method */
+  struct Implementor {
+    const Class *klass;
+    bool implemented;
+  };
+  Implementor findImplementor(const Class *klass, Smoke::Index method);
+  
+  QHash<QPair<const Class *, Smoke::Index>, Implementor> _implementors;
+  unsigned int _generation; // of RClass, when we last cleared the above
 };
 
 #endif
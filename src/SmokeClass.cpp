@@ -1,139 +1,257 @@
 #include <QHash>
+#include <QVarLengthArray>
 
 #include "SmokeClass.hpp"
 #include "SmokeMethod.hpp"
+#include "SmokeObject.hpp"
 #include "MethodCall.hpp"
+#include "NameKey.hpp"
+#include "PreservePool.hpp"
+#include "wrap.hpp"
 
 #include <Rinternals.h>
 
-// FIXME: Can the caching be generalized? E.g. cache the Method*?
-// Need to profile first
+/* Cache of resolved overloads. The key consists of the class, an
+   interned id for the method name and a tag for each argument (see
+   MethodCall::argTag()). The key lives on the stack, so a cache hit
+   does not allocate. We cache every resolution, including those with
+   a single candidate and those that fail.
+*/
+
+struct SmokeMethodKey {
+  const SmokeClass *klass;
+  int name;
+  MethodCall::ArgTags tags;
+  
+  bool operator==(const SmokeMethodKey &other) const {
+    if (klass != other.klass || name != other.name ||
+        tags.size() != other.tags.size())
+      return false;
+    for (int i = 0; i < tags.size(); i++)
+      if (tags[i] != other.tags[i])
+        return false;
+    return true;
+  }
+};
+
+inline uint qHash(const SmokeMethodKey &key) {
+  uint h = qHash(reinterpret_cast<quintptr>(key.klass)) ^ (key.name * 31);
+  for (int i = 0; i < key.tags.size(); i++)
+    h = h * 31 + qHash(key.tags[i]);
+  return h;
+}
 
 class SmokeMethodCache {
 public:
-  static Smoke::ModuleIndex find(const MethodCall &call);
-  static void insert(const MethodCall &call,
-                     const Smoke::ModuleIndex &method);
+  static bool find(const SmokeMethodKey &key, Smoke::ModuleIndex *index);
+  static void insert(const SmokeMethodKey &key,
+                     const Smoke::ModuleIndex &index);
+  static int nameId(const char *name);
 private:
-  static QHash<QByteArray,Smoke::ModuleIndex*> cache;
+  static QHash<SmokeMethodKey, Smoke::ModuleIndex> cache;
+  static QHash<NameKey, int> names;
   SmokeMethodCache() { }
 };
 
-// store index as pointer to detect cache misses
-QHash<QByteArray,Smoke::ModuleIndex*> SmokeMethodCache::cache;
+QHash<SmokeMethodKey, Smoke::ModuleIndex> SmokeMethodCache::cache;
+QHash<NameKey, int> SmokeMethodCache::names;
 
-Smoke::ModuleIndex SmokeMethodCache::find(const MethodCall &call) {
-  static Smoke::ModuleIndex missing(NULL, -1);
-  if (call.args()) { // FIXME: caching does not work yet for foreign calls
-    Smoke::ModuleIndex *index = cache[call.cacheKey()];
-    if (index)
-      return *index;
-  }
-  return missing;
+bool SmokeMethodCache::find(const SmokeMethodKey &key,
+                            Smoke::ModuleIndex *index)
+{
+  QHash<SmokeMethodKey, Smoke::ModuleIndex>::const_iterator it =
+    cache.constFind(key);
+  if (it == cache.constEnd())
+    return false;
+  *index = it.value();
+  return true;
 }
 
-void SmokeMethodCache::insert(const MethodCall &call,
+void SmokeMethodCache::insert(const SmokeMethodKey &key,
                               const Smoke::ModuleIndex &index)
 {
-  if (call.args()) {
-    cache[call.cacheKey()] = new Smoke::ModuleIndex(index);
-  }
+  cache.insert(key, index);
+}
+
+/* Method names come from R and are not stable, so we intern a copy */
+int SmokeMethodCache::nameId(const char *name) {
+  QHash<NameKey, int>::const_iterator it = names.constFind(NameKey(name));
+  if (it != names.constEnd())
+    return it.value();
+  int id = names.size() + 1;
+  names.insert(NameKey(qstrdup(name)), id);
+  return id;
 }
 
-QList<QByteArray> SmokeClass::mungedMethodNames(const MethodCall &call) const {
-  SEXP args = call.args();
-  QList<QByteArray> mungedNames;
-  mungedNames << call.method()->name();
-  if (!args) // does not yet work for foreign calls
-    return mungedNames;
-  for (int i = 0; i < length(args); i++) {
-    SEXP arg = VECTOR_ELT(args, i);
-    int nmunged = mungedNames.size();
-    for (int j = 0; j < nmunged; j++) {
-      QByteArray munged = mungedNames[j];
-      if (TYPEOF(arg) == RAWSXP) {
-        mungedNames << munged + "#"; // for QByteArray
-        munged += "$"; // for uchar*
-        /* could be a "scalar" or length-one vector */
-      } else if (isVectorAtomic(arg) && length(arg) == 1) {
-        mungedNames << munged + "?";
-        mungedNames << munged + "#"; // for QVariant
-        munged += "$";
-      } else if (isNull(arg) || isEnvironment(arg)) {
-        if (isNull(arg))
-          mungedNames << munged + "$"; // for NULL QStrings
-        munged += "#";
-      } else {
-        // this introduces annoying ambiguities
-        // really only useful if passing lists as QVariant
-        // mungedNames << munged + "#";
-        munged += "?";
+/* Overload index */
+
+/* Smoke resolves a munged name by looking in the class and then in
+   each parent, in order. We follow the same rule, so a signature
+   defined here hides the same signature in a parent. The index is
+   built lazily, one name at a time. */
+const SmokeClass::OverloadsByArity &
+SmokeClass::overloads(const char *name) const {
+  QHash<NameKey, OverloadsByArity>::const_iterator it =
+    _overloads.constFind(NameKey(name));
+  if (it != _overloads.constEnd())
+    return it.value();
+  
+  OverloadsByArity byArity;
+  const char *key = NULL;
+  for (Smoke::Index i = methmin; i <= methmax; i++) {
+    const Smoke::MethodMap &map = _smoke->methodMaps[i];
+    Smoke::Index ix = map.method;
+    Smoke::Index first = ix > 0 ? ix : _smoke->ambiguousMethodList[-ix];
+    const char *realName = _smoke->methodNames[_smoke->methods[first].name];
+    if (qstrcmp(realName, name))
+      continue;
+    key = realName;
+    const char *signature = _smoke->methodNames[map.name] + strlen(realName);
+    int arity = strlen(signature);
+    if (byArity.size() <= arity)
+      byArity.resize(arity + 1);
+    Overload overload = { _smoke, ix, signature };
+    if (ix > 0)
+      byArity[arity] << overload;
+    else if (ix < 0) {
+      for (ix = -ix; (overload.method = _smoke->ambiguousMethodList[ix]);
+           ix++)
+        byArity[arity] << overload;
+    }
+  }
+  
+  foreach(const Class *p, parents()) {
+    const SmokeClass *parent = p->smokeBase();
+    if (!parent)
+      continue;
+    const OverloadsByArity &inherited = parent->overloads(name);
+    if (byArity.size() < inherited.size())
+      byArity.resize(inherited.size());
+    for (int arity = 0; arity < inherited.size(); arity++) {
+      QVector<Overload> &mine = byArity[arity];
+      int nmine = mine.size(); // only earlier definitions hide
+      foreach(const Overload &overload, inherited[arity]) {
+        bool hidden = false;
+        for (int j = 0; j < nmine && !hidden; j++)
+          hidden = !qstrcmp(mine[j].signature, overload.signature);
+        if (!hidden)
+          mine << overload;
       }
-      mungedNames[j] = munged;
     }
   }
-  return mungedNames;
+  
+  /* Keys must outlive the index: prefer the Smoke metadata */
+  if (!key)
+    key = qstrdup(name);
+  return _overloads.insert(NameKey(key), byArity).value();
+}
+
+/* The signature characters an R argument can match */
+enum { MUNGE_SCALAR = 1, MUNGE_ARRAY = 2, MUNGE_OBJECT = 4 };
+
+static inline int mungeBit(char c) {
+  switch(c) {
+  case '$': return MUNGE_SCALAR;
+  case '?': return MUNGE_ARRAY;
+  case '#': return MUNGE_OBJECT;
+  }
+  return 0;
+}
+
+static inline int allowedMunge(SEXP arg) {
+  if (TYPEOF(arg) == RAWSXP) // QByteArray or uchar*
+    return MUNGE_OBJECT | MUNGE_SCALAR;
+  /* could be a "scalar" or length-one vector (or a QVariant) */
+  if (isVectorAtomic(arg) && length(arg) == 1)
+    return MUNGE_SCALAR | MUNGE_ARRAY | MUNGE_OBJECT;
+  if (isNull(arg)) // NULL objects, NULL QStrings
+    return MUNGE_OBJECT | MUNGE_SCALAR;
+  if (isEnvironment(arg) || SmokeObject::isHandle(arg))
+    return MUNGE_OBJECT;
+  // matching lists to '#' (QVariant) introduces annoying ambiguities
+  return MUNGE_ARRAY;
 }
 
 Smoke::ModuleIndex SmokeClass::findIndex(const MethodCall& call) const
 {
-  Smoke::ModuleIndex found = SmokeMethodCache::find(call);
-  if (found.index != -1) // cache hit, return immediately
-    return found;
+  Smoke::ModuleIndex found;
   Method *m = call.method();
-  /* Multiple mungedNames are possible, each of which may refer to
-     multiple overloaded methods. We resolve these to a flat
-     list of indices into the 'methods' array. */
-  QList<QByteArray> mungedNames = mungedMethodNames(call);
-  QList<Smoke::Index> methIds;
-  foreach (QByteArray munged, mungedNames) {
-    Smoke::ModuleIndex methId = _smoke->findMethod(name(), munged);
-    if (methId.index) {
-      found.smoke = methId.smoke; // should all have same smoke
-      Smoke::Index i = methId.smoke->methodMaps[methId.index].method;
-      if (i > 0)
-        methIds << i;
-      else if (i < 0) {
-        Smoke::Index ambig;
-        i = -i;
-        while((ambig = _smoke->ambiguousMethodList[i++]))
-          methIds << ambig;
-      } else error("Corrupt method %s::%s", name(), m->name());
+  SmokeMethodKey key;
+  key.klass = this;
+  key.name = SmokeMethodCache::nameId(m->name());
+  call.argTags(key.tags);
+  if (SmokeMethodCache::find(key, &found)) // cache hit, return immediately
+    return found;
+  
+  SEXP rargs = call.args();
+  int nargs = qMax(call.numArgs(), 0);
+  QVarLengthArray<const Overload *, 16> candidates;
+  const OverloadsByArity &byArity = overloads(m->name());
+  if (nargs < byArity.size()) {
+    const QVector<Overload> &sameArity = byArity[nargs];
+    if (rargs) { // filter the overloads by the munged signature
+      QVarLengthArray<int, 8> allowed(nargs);
+      for (int i = 0; i < nargs; i++)
+        allowed[i] = allowedMunge(VECTOR_ELT(rargs, i));
+      for (int j = 0; j < sameArity.size(); j++) {
+        const Overload &overload = sameArity[j];
+        int i = 0;
+        while (i < nargs && (mungeBit(overload.signature[i]) & allowed[i]))
+          i++;
+        if (i == nargs)
+          candidates.append(&overload);
+      }
+    } else { // a call from Smoke, so the types must match exactly
+      QVector<SmokeType> types = call.types();
+      for (int j = 0; j < sameArity.size(); j++) {
+        const Overload &overload = sameArity[j];
+        Smoke *smoke = overload.smoke;
+        Smoke::Index *args =
+          smoke->argumentList + smoke->methods[overload.method].args;
+        int i = 0;
+        while (i < nargs && SmokeType(smoke, args[i]) == types[i+1])
+          i++;
+        if (i == nargs)
+          candidates.append(&overload);
+      }
     }
   }
-  if (methIds.size() == 1) { // fast path 
-    found.index = methIds[0];
-  } else if (methIds.size() > 1) {
+  if (candidates.size() == 1) { // fast path 
+    found.smoke = candidates[0]->smoke;
+    found.index = candidates[0]->method;
+  } else if (candidates.size() > 1) {
     /* If we have more than one choice, we score the arguments */
-    SEXP rargs = call.args();
     int bestMatch = -1;
-    Smoke::Index bestMethod = -1;
+    const Overload *best = NULL;
     bool ambiguous = false;
-    Smoke *smoke = found.smoke;
-    foreach (Smoke::Index methId, methIds) {
+    for (int k = 0; k < candidates.size(); k++) {
+      const Overload *candidate = candidates[k];
+      Smoke *smoke = candidate->smoke;
+      Smoke::Method &meth = smoke->methods[candidate->method];
       int curMatch = 0;
-      Smoke::Index *args = smoke->argumentList + smoke->methods[methId].args;
-      // score each argument
-      for (int j = 0; args[j]; j++) {
+      Smoke::Index *args = smoke->argumentList + meth.args;
+      // score each argument (a call from Smoke matches exactly)
+      for (int j = 0; rargs && args[j]; j++) {
         curMatch += MethodCall::scoreArg(VECTOR_ELT(rargs, j), smoke, args[j]);
         //qDebug("curMatch: %d", curMatch);
       }
       ambiguous = (curMatch == bestMatch) || ambiguous;
-      bool constVsNonConst = curMatch == bestMatch &&
-	  smoke->methods[methId].flags & Smoke::mf_const &&
-	  !(smoke->methods[bestMethod].flags & Smoke::mf_const);
+      bool constVsNonConst = best && curMatch == bestMatch &&
+        meth.flags & Smoke::mf_const &&
+        !(best->smoke->methods[best->method].flags & Smoke::mf_const);
       if (curMatch > bestMatch || constVsNonConst) {
         //qDebug("new best match: %d, old: %d", curMatch, bestMatch);
         bestMatch = curMatch;
-        bestMethod = methId;
+        best = candidate;
         ambiguous = false;
       }
     }
     if (ambiguous)
       error("Unable to disambiguate method %s::%s", name(), m->name());
-    found.index = bestMethod;
-    SmokeMethodCache::insert(call, found); // cache
+    found.smoke = best->smoke;
+    found.index = best->method;
   }
+  SmokeMethodCache::insert(key, found);
   return found;
 }
 
@@ -141,7 +259,7 @@ Method *SmokeClass::findMethod(const MethodCall &call) const {
   Method *method = NULL;
   Smoke::ModuleIndex ind = findIndex(call);
   if (ind.index > 0)
-    method = new SmokeMethod(ind);
+    method = SmokeMethod::shared(ind);
   return method;
 }
 
@@ -157,6 +275,8 @@ QList<const Class *> SmokeClass::parents() const {
 }
 
 void SmokeClass::findMethodRange() {
+  methmin = 0; // empty range, unless we find something
+  methmax = -1;
   Smoke::Index imax = _smoke->numMethodMaps;
   Smoke::Index imin = 0, icur = -1;
   int icmp = -1;
@@ -235,16 +355,35 @@ bool SmokeClass::implementsMethod(const char *name) const {
 /* Enums */
 
 QHash<const char *, int> SmokeClass::enumValues() const {
+  QHash<const char *, int> values;
+  const EnumTable &table = enumTable();
+  for (EnumTable::const_iterator it = table.constBegin();
+       it != table.constEnd(); ++it)
+    values.insert(it.key().name(), it.value().value);
+  return values;
+}
+
+const SmokeClass::EnumTable &SmokeClass::enumTable() const {
   if (!enumValuesCached) {
-    _enumValues = createEnumValuesMap();
+    createEnumTable();
     enumValuesCached = true;
   }
-  return _enumValues;
+  return _enumTable;
 }
 
-QHash<const char *, int> SmokeClass::createEnumValuesMap() const {
-  QHash<const char *, int> values;
-  Smoke::StackItem stack[1];
+static SEXP enumSexp(const char *name, int value) {
+  SEXP ans;
+  PROTECT(ans = ScalarInteger(value));
+  setAttrib(ans, R_NamesSymbol, mkString(name));
+  setAttrib(ans, R_ClassSymbol, mkString("QtEnum"));
+  markShared(ans);
+  UNPROTECT(1);
+  return ans;
+}
+
+void SmokeClass::createEnumTable() const {
+  QVector<const char *> names;
+  QVector<Smoke::Method> enums;
   for (int i = methmin; i <= methmax; i++) {
     Smoke::Index mi = _smoke->methodMaps[i].method;
     if (mi < 0) // ambiguous method, cannot be an enum
@@ -254,15 +393,58 @@ QHash<const char *, int> SmokeClass::createEnumValuesMap() const {
       continue; // constructors are capitalized, so can be mixed-in
     if ((m.flags & Smoke::mf_enum) == 0)
       break;
-    (*_c->classFn)(m.method, 0, stack);
-    values[_smoke->methodNames[m.name]] = stack[0].s_enum;
+    names.append(_smoke->methodNames[m.name]);
+    enums.append(m);
+  }
+  _enumSexps = allocVector(VECSXP, enums.size());
+  PreservePool::preserve(_enumSexps);
+  Smoke::StackItem stack[1];
+  for (int i = 0; i < enums.size(); i++) {
+    (*_c->classFn)(enums[i].method, 0, stack);
+    EnumValue value;
+    value.value = stack[0].s_enum;
+    value.type = SmokeType(_smoke, enums[i].ret);
+    value.sexp = enumSexp(names[i], value.value);
+    SET_VECTOR_ELT(_enumSexps, i, value.sexp);
+    _enumTable.insert(names[i], value);
+  }
+  // inherited values share the QtEnum of the parent
+  foreach(const Class *p, parents()) {
+    const EnumTable &inherited = p->smokeBase()->enumTable();
+    for (EnumTable::const_iterator it = inherited.constBegin();
+         it != inherited.constEnd(); ++it)
+      if (!_enumTable.contains(it.key()))
+        _enumTable.insert(it.key(), it.value());
   }
-  foreach(const Class *p, parents())
-    values.unite(p->enumValues());
-  return values;
 }
 
 Property *SmokeClass::property(const char *name) const {
   Q_UNUSED(name);
   return NULL;
 }
+
+static void addLifecycleMethod(Smoke *smoke, Smoke::Index method,
+                               SmokeClass::Lifecycle &lifecycle)
+{
+  const Smoke::Method &meth = smoke->methods[method];
+  if (meth.flags & Smoke::mf_copyctor)
+    lifecycle.copyConstructor = method;
+  else if (meth.flags & Smoke::mf_dtor)
+    lifecycle.destructor = method;
+}
+
+/* Scans the methods of this class (not its parents) by their flags,
+   rather than looking them up by munged name */
+void SmokeClass::findLifecycle() const {
+  _lifecycle.copyConstructor = 0;
+  _lifecycle.destructor = 0;
+  for (int i = methmin; i <= methmax; i++) {
+    Smoke::Index method = _smoke->methodMaps[i].method;
+    if (method > 0)
+      addLifecycleMethod(_smoke, method, _lifecycle);
+    else if (method < 0)
+      for (Smoke::Index *m = _smoke->ambiguousMethodList - method; *m; m++)
+        addLifecycleMethod(_smoke, *m, _lifecycle);
+  }
+  _lifecycleCached = true;
+}
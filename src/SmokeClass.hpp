@@ -1,12 +1,16 @@
 #ifndef SMOKE_CLASS_H
 #define SMOKE_CLASS_H
 
+#include <QVector>
+
 #include "Class.hpp"
 #include "SmokeType.hpp"
+#include "NameKey.hpp"
 
 class SmokeClass : public Class {
 public:
-  SmokeClass() : _c(NULL), _smoke(NULL), _id(0), enumValuesCached(false) { }
+  SmokeClass() : _c(NULL), _smoke(NULL), _id(0), _enumSexps(NULL),
+                 enumValuesCached(false), _lifecycleCached(false) { }
   SmokeClass(const SmokeType &t) : _smoke(t.smoke()), _id(t.classId())  {
     init();
   }
@@ -38,6 +42,32 @@ public:
   virtual QList<const Class *> parents() const;
   virtual bool implementsMethod(const char *name) const;
   
+  /* An enum value of this class, with its R representation, a
+     QtEnum shared by every lookup */
+  struct EnumValue {
+    int value;
+    SmokeType type;
+    SEXP sexp;
+  };
+  /* Finds an enum value of this class or its parents */
+  inline const EnumValue *findEnumValue(const char *name) const {
+    const EnumTable &table = enumTable();
+    EnumTable::const_iterator it = table.constFind(name);
+    return it == table.constEnd() ? NULL : &it.value();
+  }
+  
+  /* The methods for copying and destroying an instance, as indices
+     into the Smoke methods (zero if missing), found on first use. */
+  struct Lifecycle {
+    Smoke::Index copyConstructor;
+    Smoke::Index destructor;
+  };
+  inline const Lifecycle &lifecycle() const {
+    if (!_lifecycleCached)
+      findLifecycle();
+    return _lifecycle;
+  }
+  
   inline const Smoke::Class &c() const { return *_c; }
   inline Smoke::Index classId() const { return _id; }
   inline Smoke::ClassFn classFn() const { return _c->classFn; }
@@ -62,25 +92,49 @@ public:
 
 private:
 
+  /* Enum values by name, built once per class. The names point into
+     the Smoke metadata. */
+  typedef QHash<NameKey, EnumValue> EnumTable;
+  const EnumTable &enumTable() const;
+  
+  /* One candidate for a call: a method and the munged signature
+     (the '$', '?' and '#' suffix of its munged name, one per
+     argument). The signature points into the Smoke metadata. */
+  struct Overload {
+    Smoke *smoke;
+    Smoke::Index method;
+    const char *signature;
+  };
+  /* The overloads of a method name, including those inherited,
+     indexed by the number of arguments */
+  typedef QVector<QVector<Overload> > OverloadsByArity;
+  
   Smoke::ModuleIndex findIndex(const MethodCall& call) const;
-  QList<QByteArray> mungedMethodNames(const MethodCall &call) const;
-  QHash<const char *, int> createEnumValuesMap() const;
+  const OverloadsByArity &overloads(const char *name) const;
+  void createEnumTable() const;
   void findMethodRange();
+  void findLifecycle() const;
   void init() { // common initialization code
     _c = _smoke->classes + _id;
     findMethodRange();
+    _enumSexps = NULL;
     enumValuesCached = false;
+    _lifecycleCached = false;
   }
   
   Smoke::Class *_c;
   Smoke *_smoke;
   Smoke::Index _id;
   mutable QHash<QByteArray, Method::Qualifiers> _methodQuals;
+  mutable QHash<NameKey, OverloadsByArity> _overloads;
   int methmin;
   int methmax;
-  mutable QHash<const char *, int> _enumValues;
+  mutable EnumTable _enumTable;
+  mutable SEXP _enumSexps; // keeps the QtEnum values of this class
   mutable bool enumValuesCached;
   mutable QList<const Class *> _parents;
+  mutable Lifecycle _lifecycle;
+  mutable bool _lifecycleCached;
 };
 
 #endif
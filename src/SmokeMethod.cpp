@@ -28,13 +28,28 @@ void SmokeMethod::invoke(SmokeObject *obj, Smoke::Stack stack) {
   setLastError(NoError);
 }
 
+/* Computed once; later calls only copy a reference */
 QVector<SmokeType> SmokeMethod::types() const {
-  Smoke::Index *argTypes = args();
-  QVector<SmokeType> t(_m->numArgs + 1);
-  t[0] = returnType();
-  for (int i = 0; i < _m->numArgs; i++)
-    t[i+1] = SmokeType(_smoke, argTypes[i]);
-  return t;
+  if (_types.isEmpty()) {
+    Smoke::Index *argTypes = args();
+    _types.resize(_m->numArgs + 1);
+    _types[0] = returnType();
+    for (int i = 0; i < _m->numArgs; i++)
+      _types[i+1] = SmokeType(_smoke, argTypes[i]);
+  }
+  return _types;
+}
+
+SmokeMethod *SmokeMethod::shared(Smoke::ModuleIndex ind) {
+  SmokeModule *module = SmokeModule::module(ind.smoke);
+  if (!module) // not ours to keep
+    return new SmokeMethod(ind);
+  SmokeMethod *&method = module->sharedMethod(ind.index);
+  if (!method) {
+    method = new SmokeMethod(ind);
+    method->_shared = true;
+  }
+  return method;
 }
 
 const Class *SmokeMethod::klass() const {
@@ -12,6 +12,8 @@ private:
   Smoke::Method *_m;
   Smoke *_smoke;
   Smoke::Index _id;
+  mutable QVector<SmokeType> _types;
+  bool _shared;
 
   void findMethod() {
     if(_id < 0 || _id > _smoke->numMethods) _id = 0;
@@ -19,14 +21,19 @@ private:
   }
   
 public:
-  SmokeMethod() : _m(0), _smoke(0), _id(0) {}
-  SmokeMethod(Smoke *s, Smoke::Index i) : _smoke(s), _id(i) {
+  SmokeMethod() : _m(0), _smoke(0), _id(0), _shared(false) {}
+  SmokeMethod(Smoke *s, Smoke::Index i) : _smoke(s), _id(i), _shared(false) {
     findMethod();
   }
-  SmokeMethod(Smoke::ModuleIndex ind) : _smoke(ind.smoke), _id(ind.index)
+  SmokeMethod(Smoke::ModuleIndex ind)
+    : _smoke(ind.smoke), _id(ind.index), _shared(false)
   {
     findMethod();
   }
+
+  /* The flyweight for a method, which lives as long as its module */
+  static SmokeMethod *shared(Smoke::ModuleIndex ind);
+  virtual bool isShared() const { return _shared; }
     
   inline Smoke *smoke() const { return _smoke; }
   inline Smoke::Index methodId() const { return _id; }
@@ -1,17 +1,125 @@
 #include "SmokeModule.hpp"
 #include "SmokeList.hpp"
+#include "MethodCall.hpp"
 
 QHash<Smoke *, SmokeModule *> SmokeModule::modules;
+SmokeModule *SmokeModule::lastModule = NULL;
+QHash<NameKey, int> SmokeModule::classNumbers;
+QSet<QByteArray> SmokeModule::overriddenNames;
 
 SmokeModule *SmokeModule::registerModule(SmokeModule *module) {
   modules[module->smoke()] = module;
+  lastModule = NULL;
+  module->indexTypeHandlers();
+  foreach(const QByteArray &name, overriddenNames)
+    module->markOverridden(name.constData());
   return module;
 }
 
+/* Nearly every lookup is for the same (Qt) module */
 SmokeModule *SmokeModule::module(Smoke *smoke) {
-  return modules[smoke];
+  if (!lastModule || lastModule->smoke() != smoke)
+    lastModule = modules.value(smoke);
+  return lastModule;
 }
 
 SmokeList SmokeModule::smokes() {
   return SmokeList(modules.keys());
 }
+
+void SmokeModule::indexTypeHandlers() {
+  Smoke *s = smoke();
+  _typeHandlers.resize(s->numTypes + 1);
+  for (Smoke::Index i = 0; i <= s->numTypes; i++)
+    _typeHandlers[i] = MethodCall::findTypeHandler(SmokeType(s, i));
+}
+
+void SmokeModule::markOverridden(const char *name) {
+  Smoke::Index id = smoke()->idMethodName(name).index;
+  if (!id)
+    return;
+  if (_overridden.size() <= id)
+    _overridden.resize(smoke()->numMethodNames + 1);
+  _overridden.setBit(id);
+}
+
+void SmokeModule::setOverridden(const char *name) {
+  overriddenNames.insert(name);
+  foreach(SmokeModule *module, modules)
+    module->markOverridden(name);
+}
+
+void SmokeModule::indexAllTypeHandlers() {
+  foreach(SmokeModule *module, modules)
+    module->indexTypeHandlers();
+}
+
+/* Class names point into the Smoke metadata, so they can serve as
+   keys */
+int SmokeModule::classNumber(const char *name) {
+  QHash<NameKey, int>::const_iterator it = classNumbers.constFind(name);
+  if (it != classNumbers.constEnd())
+    return it.value();
+  int number = classNumbers.size();
+  classNumbers.insert(name, number);
+  return number;
+}
+
+static inline void addAncestors(QBitArray &ancestors, const QBitArray &more) {
+  if (ancestors.size() < more.size())
+    ancestors.resize(more.size());
+  for (int i = 0; i < more.size(); i++)
+    if (more.testBit(i))
+      ancestors.setBit(i);
+}
+
+const QBitArray &SmokeModule::ancestry(Smoke::Index classId) {
+  Smoke *s = smoke();
+  if (_ancestry.isEmpty())
+    _ancestry.resize(s->numClasses + 1);
+  if (!_ancestry[classId].isEmpty()) // never empty when computed
+    return _ancestry[classId];
+  const Smoke::Class &c = s->classes[classId];
+  QBitArray ancestors;
+  if (c.external) { // defer to the definition
+    Smoke::ModuleIndex def = Smoke::findClass(c.className);
+    SmokeModule *defModule = def.smoke ? module(def.smoke) : NULL;
+    if (defModule && def.smoke != s)
+      ancestors = defModule->ancestry(def.index);
+  }
+  if (ancestors.isEmpty()) {
+    int self = classNumber(c.className);
+    ancestors.resize(self + 1);
+    ancestors.setBit(self);
+    for (Smoke::Index p = c.parents; s->inheritanceList[p]; p++)
+      addAncestors(ancestors, ancestry(s->inheritanceList[p]));
+  }
+  _ancestry[classId] = ancestors;
+  return _ancestry[classId];
+}
+
+bool SmokeModule::isDerivedFrom(Smoke *smoke, Smoke::Index classId,
+                                const char *baseName)
+{
+  SmokeModule *m = module(smoke);
+  if (!m) {
+    Smoke::ModuleIndex base = Smoke::findClass(baseName);
+    return Smoke::isDerivedFrom(smoke, classId, base.smoke, base.index);
+  }
+  if (!classId)
+    return false;
+  // the ancestors are numbered as the ancestry is computed
+  const QBitArray &ancestors = m->ancestry(classId);
+  QHash<NameKey, int>::const_iterator it = classNumbers.constFind(baseName);
+  if (it == classNumbers.constEnd())
+    return false;
+  return it.value() < ancestors.size() && ancestors.testBit(it.value());
+}
+
+bool SmokeModule::isDerivedFrom(Smoke *smoke, Smoke::Index classId,
+                                Smoke *baseSmoke, Smoke::Index baseId)
+{
+  if (!smoke || !baseSmoke || !baseId)
+    return false;
+  return isDerivedFrom(smoke, classId, baseSmoke->classes[baseId].className);
+}
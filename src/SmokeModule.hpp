@@ -2,13 +2,19 @@
 #define R_QT_MODULE_H
 
 #include <QHash>
+#include <QSet>
+#include <QVector>
+#include <QBitArray>
 
 #include <smoke.h>
 
 #include "RSmokeBinding.hpp"
+#include "NameKey.hpp"
 
 class SmokeList;
 class SmokeObject;
+class SmokeMethod;
+struct TypeHandler;
 
 typedef int (*ResolveClassIdFn)(const SmokeObject * so);
 typedef bool (*MemoryIsOwnedFn)(const SmokeObject *so);
@@ -20,8 +26,19 @@ private:
   RSmokeBinding *_binding;
   ResolveClassIdFn _resolveClassId;
   MemoryIsOwnedFn _memoryIsOwned;
+  QVector<TypeHandler *> _typeHandlers;
+  QVector<SmokeMethod *> _sharedMethods;
+  QBitArray _overridden;
+  QVector<QBitArray> _ancestry;
   
   static QHash<Smoke *, SmokeModule *> modules;
+  static SmokeModule *lastModule;
+  static QHash<NameKey, int> classNumbers;
+  static QSet<QByteArray> overriddenNames;
+
+  const QBitArray &ancestry(Smoke::Index classId);
+  void markOverridden(const char *name);
+  static int classNumber(const char *name);
   
 public:
 
@@ -40,8 +57,41 @@ public:
   bool memoryIsOwned(const SmokeObject *so) {
     return _memoryIsOwned(so);
   }
+
+  /* The TypeHandler for each type, indexed by type id. This saves
+     hashing the type name for every argument we marshal or score. */
+  TypeHandler *typeHandler(Smoke::Index type) const {
+    return _typeHandlers[type];
+  }
+  void indexTypeHandlers();
+
+  /* Slot for the shared SmokeMethod, by method id */
+  SmokeMethod *&sharedMethod(Smoke::Index method) {
+    if (_sharedMethods.isEmpty())
+      _sharedMethods.resize(smoke()->numMethods + 1);
+    return _sharedMethods[method];
+  }
+  
+  /* Whether any R class defines a method with this name id, which is
+     necessary for R to override a virtual method. The names are kept,
+     so that modules registered later learn of them, too. */
+  bool isOverridden(Smoke::Index name) const {
+    return name < _overridden.size() && _overridden.testBit(name);
+  }
+  static void setOverridden(const char *name);
+
+  /* Constant-time derivation checks. Classes are numbered by name
+     across modules, so an external class is the same as its
+     definition. The first check on a class computes the set of its
+     ancestors (including itself) as a bit array over those numbers. */
+  static bool isDerivedFrom(Smoke *smoke, Smoke::Index classId,
+                            Smoke *baseSmoke, Smoke::Index baseId);
+  static bool isDerivedFrom(Smoke *smoke, Smoke::Index classId,
+                            const char *baseName);
   
   static SmokeModule *registerModule(SmokeModule *module);
+  /* Called when the set of TypeHandlers changes */
+  static void indexAllTypeHandlers();
   static SmokeModule *module(Smoke *smoke);
   static SmokeList smokes();
 };
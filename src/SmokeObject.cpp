@@ -2,6 +2,10 @@
 #include "SmokeClass.hpp"
 #include "SmokeModule.hpp"
 #include "InstanceObjectTable.hpp"
+#include "PreservePool.hpp"
+#include "DestructionQueue.hpp"
+
+#include <QObject>
 
 #include <Rinternals.h>
 #undef warning
@@ -10,7 +14,53 @@
 
 /* One SmokeObject for each object,
    to ensure 1-1 mapping from Qt objects to R objects */
-QHash<void *, SmokeObject *> SmokeObject::instances;
+PointerTable<SmokeObject> SmokeObject::instances;
+int SmokeObject::environments = 0;
+
+/* SmokeObjects are allocated from slabs of records, so that they are
+   packed together, and creating one rarely calls malloc(). Released
+   records go on a free list for reuse; the slabs are never freed. */
+union SlabRecord {
+  SlabRecord *next;
+  char data[sizeof(SmokeObject)];
+  void *align;
+};
+
+enum { RecordsPerSlab = 512 };
+static SlabRecord *freeRecords = NULL;
+static int numSlabs = 0;
+static int numRecords = 0;
+
+void *SmokeObject::operator new(size_t size) {
+  Q_ASSERT(size == sizeof(SmokeObject));
+  Q_UNUSED(size);
+  if (!freeRecords) {
+    SlabRecord *slab =
+      static_cast<SlabRecord *>(::operator new(sizeof(SlabRecord) *
+                                               RecordsPerSlab));
+    for (int i = 0; i < RecordsPerSlab - 1; i++)
+      slab[i].next = slab + i + 1;
+    slab[RecordsPerSlab - 1].next = NULL;
+    freeRecords = slab;
+    numSlabs++;
+  }
+  SlabRecord *record = freeRecords;
+  freeRecords = record->next;
+  numRecords++;
+  return record;
+}
+
+void SmokeObject::operator delete(void *ptr) {
+  if (!ptr)
+    return;
+  SlabRecord *record = static_cast<SlabRecord *>(ptr);
+  record->next = freeRecords;
+  freeRecords = record;
+  numRecords--;
+}
+
+int SmokeObject::slabCapacity() { return numSlabs * RecordsPerSlab; }
+int SmokeObject::slabRecords() { return numRecords; }
 
 SmokeObject * SmokeObject::fromPtr(void *ptr, const Class *klass,
                                    bool allocated, bool copy)
@@ -19,7 +69,7 @@ SmokeObject * SmokeObject::fromPtr(void *ptr, const Class *klass,
     error("Attempt to create SmokeObject with NULL class");
   if (!ptr)
     error("Attempt to create SmokeObject with NULL pointer");
-  SmokeObject *so = instances[ptr];
+  SmokeObject *so = instances.value(ptr);
   if (!so) {
     so = new SmokeObject(ptr, klass, allocated);
 #ifdef MEM_DEBUG
@@ -27,7 +77,7 @@ SmokeObject * SmokeObject::fromPtr(void *ptr, const Class *klass,
 #endif
     // record this ASAP, resolveClassId() needs it for virtual callbacks
     if (allocated) // do not record unallocated; not informed when deleted
-      instances[so->ptr()] = so;
+      instances.insert(so->ptr(), so);
 #ifdef MEM_DEBUG
     else qDebug("%p: unallocated, not registering pointer", so);
 #endif
@@ -43,7 +93,7 @@ SmokeObject * SmokeObject::fromPtr(void *ptr, const Class *klass,
              so->klass()->name());
 #endif    
     if (so->ptr() != ptr) { // must be multiple inheritance, recache
-      SmokeObject *tmp_so = instances[so->ptr()];
+      SmokeObject *tmp_so = instances.value(so->ptr());
 #ifdef MEM_DEBUG
       qDebug("%p: multiple inheritance detected, switch to %p", so, so->ptr());
 #endif
@@ -54,13 +104,13 @@ SmokeObject * SmokeObject::fromPtr(void *ptr, const Class *klass,
         delete so;
         so = tmp_so;
         copy = false; // don't think we every want to copy here
-      } else instances[so->ptr()] = so;
+      } else instances.insert(so->ptr(), so);
       instances.remove(ptr);
     }
     if (copy) { // copy the data
       void *tmp_ptr = so->ptr();
       so->_ptr = so->clonePtr(); 
-      instances[so->ptr()] = so; // update the instances hash after cloning
+      instances.insert(so->ptr(), so); // update the instances hash after cloning
       instances.remove(tmp_ptr);
 #ifdef MEM_DEBUG
       qDebug("%p: copied to %p", so, so->ptr());
@@ -124,8 +174,23 @@ SmokeObject::sexpFromPtr(void *ptr, const SmokeType &type,
       SmokeObject::fromPtr(&val, NULL, #klass, false, true);      \
 })
 
+static SEXP handleTag() {
+  static SEXP tag = install("RQtHandle");
+  return tag;
+}
+
+bool SmokeObject::isHandle(SEXP sexp) {
+  return TYPEOF(sexp) == EXTPTRSXP && R_ExternalPtrTag(sexp) == handleTag();
+}
+
 SmokeObject * SmokeObject::fromSexp(SEXP sexp)
 {
+  if (isHandle(sexp)) {
+    SmokeObject *so = static_cast<SmokeObject *>(R_ExternalPtrAddr(sexp));
+    if (!so)
+      error("Attempt to access invalid instance");
+    return so;
+  }
   if (!isEnvironment(sexp))
     error("Expected an environment");
   return InstanceObjectTable::instanceFromSexp(HASHTAB(sexp));
@@ -133,27 +198,16 @@ SmokeObject * SmokeObject::fromSexp(SEXP sexp)
 
 SmokeObject::SmokeObject(void *ptr, const Class *klass, bool allocated)
   : _ptr(ptr), _klass(klass), _allocated(allocated), _sexp(NULL),
-    _fieldEnv(NULL)
+    _handle(NULL), _fieldEnv(NULL), _queueIndex(-1)
 {
 }
 
 void SmokeObject::maybeDestroy() {
   if (_allocated && !memoryIsOwned()) {
 #ifdef MEM_DEBUG
-    qDebug("%p: invoking destructor on %p", this, ptr());
+    qDebug("%p: queueing %p for destruction", this, ptr());
 #endif
-    const char *cname = _klass->smokeBase()->name();
-    const char *colon = strrchr(cname, ':');
-    void *this_ptr = _ptr;
-    if (colon)
-      cname = colon + 1;
-    char *destructor = new char[strlen(cname) + 2];
-    destructor[0] = '~';
-    strcpy(destructor + 1, cname);
-    invokeMethod(destructor); // might cause 'this' to be destructed
-    delete[] destructor;
-    if (instances.contains(this_ptr)) // we are still around
-      delete this;
+    DestructionQueue::enqueue(this);
   } else if (!_allocated) {
 #ifdef MEM_DEBUG
     if (!_allocated)
@@ -170,35 +224,72 @@ void SmokeObject::maybeDestroy() {
   }
 }
 
+/* Called by the DestructionQueue. The object might have been claimed
+   since it was queued, so we check again. */
+void SmokeObject::destroy() {
+  if (memoryIsOwned())
+    return;
+  if (instanceOf("QObject")) {
+    /* Leave it to Qt, which deletes it once the events pending for it
+       are delivered; our binding then deletes us */
+#ifdef MEM_DEBUG
+    qDebug("%p: deleting %p later", this, ptr());
+#endif
+    static_cast<QObject *>(castPtr("QObject"))->deleteLater();
+    return;
+  }
+#ifdef MEM_DEBUG
+  qDebug("%p: invoking destructor on %p", this, ptr());
+#endif
+  Smoke *smoke = this->smoke();
+  Smoke::Index destructor = _klass->smokeBase()->lifecycle().destructor;
+  void *this_ptr = _ptr;
+  if (destructor) {
+    Smoke::Method &m = smoke->methods[destructor];
+    (*smoke->classes[m.classId].classFn)(m.method, _ptr, NULL);
+  } else qWarning("Cannot find destructor for %s, leaking %p", className(),
+                  _ptr);
+  if (instances.value(this_ptr) == this) // we are still around
+    delete this;
+}
+
 void SmokeObject::invalidateSexp() {
 #ifdef MEM_DEBUG
   qDebug("%p: invalidating sexp %p (%s)", this, _sexp, _klass->name());
 #endif
   _sexp = NULL;
+  environments--;
   maybeDestroy();
 }
 
+void SmokeObject::invalidateHandle() {
+#ifdef MEM_DEBUG
+  qDebug("%p: invalidating handle %p (%s)", this, _handle, _klass->name());
+#endif
+  _handle = NULL;
+  maybeDestroy();
+}
+
+void SmokeObject::finalizeHandle(SEXP handle) {
+  SmokeObject *so = static_cast<SmokeObject *>(R_ExternalPtrAddr(handle));
+  if (so) // not orphaned
+    so->invalidateHandle();
+}
+
 void SmokeObject::invalidateInternalTable(SEXP sexp) {
 #ifdef MEM_DEBUG
   qDebug("%p: invalidating internal table %p", this, sexp);
 #endif
-  _internalTables.remove(sexp);
+  if (_internalTables.remove(sexp))
+    environments--;
   if (_internalTables.isEmpty()) {
     maybeDestroy();
   }
 }
 
 void SmokeObject::castSexp(SEXP sexp) {
-  SEXP rclasses;
-  QList<const Class *> classes = _klass->ancestors();
-  classes.prepend(_klass);
-  rclasses = allocVector(STRSXP, classes.size() + 3);
-  setAttrib(sexp, R_ClassSymbol, rclasses);
-  for (int i = 0; i < classes.size(); i++)
-    SET_STRING_ELT(rclasses, i, mkChar(classes[i]->name()));
-  SET_STRING_ELT(rclasses, length(rclasses) - 3, mkChar("UserDefinedDatabase"));
-  SET_STRING_ELT(rclasses, length(rclasses) - 2, mkChar("environment"));
-  SET_STRING_ELT(rclasses, length(rclasses) - 1, mkChar("RQtObject"));
+  setAttrib(sexp, R_ClassSymbol, isHandle(sexp) ? _klass->handleClasses() :
+            _klass->instanceClasses());
 }
   
 SEXP SmokeObject::createSexp(SEXP parentEnv) {
@@ -214,6 +305,7 @@ SEXP SmokeObject::sexp() {
   if (!_sexp) {
     PROTECT(_sexp = createSexp(R_EmptyEnv));
     SET_HASHTAB(_sexp, _klass->createObjectTable(this)->sexp());
+    environments++;
 #ifdef MEM_DEBUG
     qDebug("%p: created sexp %p", this, _sexp);
 #endif
@@ -222,12 +314,27 @@ SEXP SmokeObject::sexp() {
   return _sexp;
 }
 
+/* The handle is not counted among the environments, and it needs no
+   object table: just a finalizer */
+SEXP SmokeObject::handleSexp() {
+  if (!_handle) {
+    PROTECT(_handle = R_MakeExternalPtr(this, handleTag(), R_NilValue));
+    R_RegisterCFinalizer(_handle, finalizeHandle);
+    castSexp(_handle);
+#ifdef MEM_DEBUG
+    qDebug("%p: created handle %p", this, _handle);
+#endif
+    UNPROTECT(1);
+  }
+  return _handle;
+}
+
 SEXP SmokeObject::fieldEnv() const {
   if (!_fieldEnv) {
     _fieldEnv = allocSExp(ENVSXP);
     SET_ENCLOS(_fieldEnv, R_EmptyEnv);
     SET_FRAME(_fieldEnv, R_NilValue);
-    R_PreserveObject(_fieldEnv);
+    PreservePool::preserve(_fieldEnv);
   }
   return _fieldEnv;
 }
@@ -243,7 +350,7 @@ SmokeModule *SmokeObject::module() const {
 bool SmokeObject::memoryIsOwned() const {
   // NOTE: calling the module's memoryIsOwned() might resurrect sexps;
   // if so, they become orphans
-  bool owned = _sexp || !_internalTables.isEmpty();
+  bool owned = ownedByR();
   if (!owned) {
     owned = module()->memoryIsOwned(this);
 #ifdef MEM_DEBUG
@@ -252,69 +359,26 @@ bool SmokeObject::memoryIsOwned() const {
 #endif
   }
 #ifdef MEM_DEBUG
-  else qDebug("%p: memory is owned by R, sexp: %p, %d tables", this, _sexp,
-                _internalTables.size());
+  else qDebug("%p: memory is owned by R, sexp: %p, handle: %p, %d tables",
+              this, _sexp, _handle, _internalTables.size());
 #endif
   return owned;
 }
 
 // only works for pure Smoke instances, but that may be OK
 void * SmokeObject::clonePtr() const {
-  Smoke *smoke = this->smoke();
-  const char *className = _klass->name();
-  int classNameLen = strlen(className);
-
-  // copy constructor signature
-  QByteArray ccSig(className);
-  int pos = ccSig.lastIndexOf("::");
-  if (pos != -1) {
-    ccSig = ccSig.mid(pos + strlen("::"));
-  }
-  ccSig.append("#");
-  Smoke::ModuleIndex ccId = smoke->findMethodName(className, ccSig);
-
-  char *ccArg = new char[classNameLen + 8];
-  sprintf(ccArg, "const %s&", className);
-
-  Smoke::ModuleIndex classIdx = Smoke::ModuleIndex(smoke, classId());
-  Smoke::ModuleIndex ccMeth = smoke->findMethod(classIdx, ccId);
-
-  if (ccMeth.index == 0) {
-    qWarning("failed to construct copy: %s %p\n", className, _ptr);
-    delete[] ccArg;
+  const SmokeClass *base = _klass->smokeBase();
+  Smoke::Index copyConstructor = base->lifecycle().copyConstructor;
+  if (!copyConstructor) {
+    qWarning("failed to construct copy: %s %p\n", className(), _ptr);
     return 0;
   }
-  Smoke::Index method = ccMeth.smoke->methodMaps[ccMeth.index].method;
-  if (method > 0) {
-    delete[] ccArg;
-    if (!(ccMeth.smoke->methods[method].flags & Smoke::mf_copyctor)) {
-      qCritical("failed to construct copy: %s %p\n", className, _ptr);
-      return 0;
-    }
-    ccMeth.index = method;
-  } else {
-    // ambiguous method, pick the copy constructor
-    Smoke::Index i = -method;
-    while (ccMeth.smoke->ambiguousMethodList[i]) {
-      if (ccMeth.smoke->methods[ccMeth.smoke->ambiguousMethodList[i]].flags &
-          Smoke::mf_copyctor)
-        break;
-      i++;
-    }
-    delete[] ccArg;
-    ccMeth.index = ccMeth.smoke->ambiguousMethodList[i];
-    if (ccMeth.index == 0) {
-      qCritical("construct_copy() failed %s %p\n", className, _ptr);
-      return 0;
-    }
-  }
 
-  // Okay, ccMeth is the copy constructor. Time to call it.
   Smoke::StackItem args[2];
   args[0].s_voidp = 0;
   args[1].s_voidp = _ptr;
-  Smoke::ClassFn fn = smoke->classes[classId()].classFn;
-  (*fn)(smoke->methods[ccMeth.index].method, 0, args);
+  Smoke::ClassFn fn = base->classFn();
+  (*fn)(base->smoke()->methods[copyConstructor].method, 0, args);
 
   // Initialize the binding for the new instance
   Smoke::StackItem s[2];
@@ -334,6 +398,8 @@ SmokeObject::cast(const Class *klass) {
   _klass = klass;
   if (_sexp)
     castSexp(_sexp);
+  if (_handle)
+    castSexp(_handle);
 }
 
 /* Cast the instance pointer to a parent class. This is necessary,
@@ -350,16 +416,13 @@ SmokeObject::castPtr(const char *className, bool clone) const {
 
 bool // result undefined if class names are not all unique
 SmokeObject::instanceOf(const char *className) const {
-  Smoke *smoke = this->smoke();
-  // the base class must be 'found', i.e., it cannot be external
-  Smoke::ModuleIndex other = smoke->findClass(className);
-  return smoke->isDerivedFrom(smoke, classId(), other.smoke, other.index);
+  return SmokeModule::isDerivedFrom(smoke(), classId(), className);
 }
 
 bool
 SmokeObject::instanceOf(const SmokeType &type) const {
-  Smoke *smoke = this->smoke();
-  return smoke->isDerivedFrom(smoke, classId(), type.smoke(), type.classId());
+  return SmokeModule::isDerivedFrom(smoke(), classId(), type.smoke(),
+                                   type.classId());
 }
 
 void
@@ -402,6 +465,7 @@ SEXP SmokeObject::internalTable() {
   table->setInternal(true);
   _internalTable = table->sexp();
   _internalTables.insert(_internalTable);
+  environments++;
 #ifdef MEM_DEBUG
     qDebug("%p: creating internal table %p", this, _internalTable);
 #endif
@@ -416,24 +480,59 @@ SEXP SmokeObject::enclose(SEXP fun) {
   return dupFun;
 }
 
+/* The enclosure is the value of a weak reference keyed on sexp(), so
+   it is dropped along with the public environment, and it does not
+   keep the instance alive any longer than that environment does. The
+   value also holds the closure, so that the closure, our hash key,
+   cannot be collected and its address reused while the entry is
+   valid.
+*/
+SEXP SmokeObject::enclosure(SEXP fun) {
+  SEXP ref = _enclosures.value(fun);
+  if (ref) {
+    if (_sexp && R_WeakRefKey(ref) == _sexp)
+      return VECTOR_ELT(R_WeakRefValue(ref), 0);
+    PreservePool::release(ref);
+  }
+  SEXP key, value;
+  PROTECT(key = sexp());
+  PROTECT(value = allocVector(VECSXP, 2));
+  SET_VECTOR_ELT(value, 0, enclose(fun));
+  SET_VECTOR_ELT(value, 1, fun);
+  ref = R_MakeWeakRef(key, value, R_NilValue, FALSE);
+  PreservePool::preserve(ref);
+  _enclosures.insert(fun, ref);
+  UNPROTECT(2);
+  return VECTOR_ELT(value, 0);
+}
+
 void SmokeObject::orphanTable(SEXP sexp) const {
   InstanceObjectTable *table = 
     static_cast<InstanceObjectTable *>(ObjectTable::fromSexp(sexp));
   table->setInstance(NULL);
 }
 
-void SmokeObject::orphanSexp() {
-  SEXP old_classes = getAttrib(_sexp, R_ClassSymbol);
+static void markInvalid(SEXP sexp) {
+  SEXP old_classes = getAttrib(sexp, R_ClassSymbol);
   SEXP new_classes;
   PROTECT(new_classes = allocVector(STRSXP, length(old_classes) + 1));
   SET_STRING_ELT(new_classes, 0, mkChar("RQtInvalid"));
   for (int i = 0; i < length(old_classes); i++)
     SET_STRING_ELT(new_classes, i + 1, STRING_ELT(old_classes, i));
-  setAttrib(_sexp, R_ClassSymbol, new_classes);
+  setAttrib(sexp, R_ClassSymbol, new_classes);
   UNPROTECT(1);
+}
+
+void SmokeObject::orphanSexp() {
+  markInvalid(_sexp);
   orphanTable(HASHTAB(_sexp));
 }
 
+void SmokeObject::orphanHandle() {
+  markInvalid(_handle);
+  R_ClearExternalPtr(_handle);
+}
+
 SmokeObject *SmokeObject::convertImplicitly(const SmokeType &type) const {
   const Class *cl = Class::fromSmokeId(type.smoke(), type.classId());
   Method *meth = cl->findImplicitConverter(this);
@@ -458,6 +557,13 @@ SmokeObject::~SmokeObject() {
     qDebug("%p: orphaned sexp %p", this, _sexp);
 #endif
     orphanSexp();
+    environments--;
+  }
+  if (_handle) {
+#ifdef MEM_DEBUG
+    qDebug("%p: orphaned handle %p", this, _handle);
+#endif
+    orphanHandle();
   }
   for (QSet<SEXP>::const_iterator it = _internalTables.begin();
        it != _internalTables.end(); ++it) {
@@ -466,7 +572,12 @@ SmokeObject::~SmokeObject() {
 #endif
     orphanTable(*it);
   }
+  environments -= _internalTables.size();
   if (_fieldEnv)
-    R_ReleaseObject(_fieldEnv);
+    PreservePool::release(_fieldEnv);
+  foreach(SEXP ref, _enclosures)
+    PreservePool::release(ref);
+  if (_queueIndex >= 0)
+    DestructionQueue::remove(this);
   instances.remove(_ptr);
 }
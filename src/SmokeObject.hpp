@@ -5,6 +5,8 @@
 #include <QSet>
 #include <smoke.h>
 
+#include "PointerTable.hpp"
+
 class SmokeModule;
 class Class;
 class SmokeType;
@@ -48,6 +50,11 @@ public:
   /* Core behaviors */
   inline void *ptr() const { return _ptr; }
   SEXP sexp();
+  /* A lightweight reference for values that are often only passed to
+     another method: a classed externalptr, without the environment
+     and object table. The '$' method promotes it to sexp(). */
+  SEXP handleSexp();
+  static bool isHandle(SEXP sexp);
   SEXP internalSexp(SEXP env);
   void invalidateSexp();
   void invalidateInternalTable(SEXP sexp);
@@ -70,14 +77,40 @@ public:
   bool instanceOf(const char *className) const;
   bool instanceOf(const SmokeType &type) const;
   SEXP enclose(SEXP fun);
+  /* Like enclose(), but reuses the enclosure while sexp() lives */
+  SEXP enclosure(SEXP fun);
   SmokeObject *convertImplicitly(const SmokeType &type) const;
+
+  /* Diagnostics */
+  static inline const PointerTable<SmokeObject> &instanceTable() {
+    return instances;
+  }
+  static int slabCapacity();
+  static int slabRecords(); // the live SmokeObjects
+  static inline int environmentCount() { return environments; }
+  inline bool hasSexp() const { return _sexp; }
+  /* Unlike memoryIsOwned(), does not ask the module, which might
+     change the object (e.g., a visible QWidget) */
+  inline bool ownedByR() const {
+    return _sexp || _handle || !_internalTables.isEmpty();
+  }
+  inline int internalSexpCount() const { return _internalTables.size(); }
+  inline bool hasFieldEnv() const { return _fieldEnv; }
+  
+  /* SmokeObjects are allocated from slabs */
+  static void *operator new(size_t size);
+  static void operator delete(void *ptr);
   
 private:
 
   void orphanTable(SEXP sexp) const;
   void orphanSexp();
+  void orphanHandle();
+  void invalidateHandle();
+  static void finalizeHandle(SEXP handle);
   SEXP internalTable();
   void maybeDestroy();
+  void destroy();
   void castSexp(SEXP sexp);
   SEXP createSexp(SEXP parentEnv);
   static SmokeObject *fromValueSexp(SEXP sexp);
@@ -86,12 +119,18 @@ private:
   const Class *_klass;
   bool _allocated;
   SEXP _sexp;  
+  SEXP _handle;
   QSet<SEXP> _internalTables;
   mutable SEXP _fieldEnv;
+  QHash<SEXP, SEXP> _enclosures; // closure => weak reference
+  int _queueIndex; // in the DestructionQueue, or -1
   
-  static QHash<void *, SmokeObject *> instances;
+  static PointerTable<SmokeObject> instances;
+  static int environments; // public and internal, of all instances
 
   SmokeObject(void *ptr, const Class *klass, bool allocated = false);
+
+  friend class DestructionQueue;
 };
 
 #endif
@@ -0,0 +1,24 @@
+/* Counts calls to malloc(). Preload this library into R to measure
+   the allocations made by the bindings:
+
+   LD_PRELOAD=/path/to/libmallocount.so Rscript benchmark-malloc.R
+
+   Requires glibc, for __libc_malloc(). Operator new goes through
+   malloc(), so C++ allocations are counted, too.
+*/
+
+#include <stddef.h>
+
+extern void *__libc_malloc(size_t size);
+
+static double mallocs = 0;
+
+void *malloc(size_t size) {
+  mallocs++;
+  return __libc_malloc(size);
+}
+
+/* Called through .C(), so the library needs no R headers */
+void mallocount(double *count) {
+  *count = mallocs;
+}
@@ -1,5 +1,6 @@
 #include "SmokeObject.hpp"
 #include "Class.hpp"
+#include "RClass.hpp"
 
 #include <Rinternals.h>
 
@@ -15,8 +16,25 @@ SEXP qt_qenclose(SEXP x, SEXP fun) {
   return SmokeObject::fromSexp(x)->enclose(fun);
 }
 
+extern "C"
+SEXP qt_qpromote(SEXP x) {
+  return SmokeObject::fromSexp(x)->sexp();
+}
+
 extern "C"
 SEXP qt_qinitClass(SEXP x) {
   Class::fromSexp(x, true);
   return R_NilValue;
 }
+
+extern "C"
+SEXP qt_qmethodChanged(SEXP name) {
+  RClass::methodChanged(CHAR(asChar(name)));
+  return R_NilValue;
+}
+
+extern "C"
+SEXP qt_qclassChanged() {
+  RClass::classChanged();
+  return R_NilValue;
+}
@@ -59,6 +59,7 @@
 
 #include "SmokeObject.hpp"
 #include "Class.hpp"
+#include "PreservePool.hpp"
 #include "convert.hpp"
 
 #undef isNull
@@ -345,6 +346,18 @@ bool qvariant_into_vector(QVariant variant, SEXP v, int index) {
   return(success);
 }
 
+/* From an instance environment or handle */
+static QVariant qvariant_from_object(SEXP rvalue) {
+  SmokeObject *so = SmokeObject::fromSexp(rvalue);
+  if (so->instanceOf("QObject"))
+    return
+      qVariantFromValue(reinterpret_cast<QObject *>(so->castPtr("QObject")));
+  QMetaType::Type type = (QMetaType::Type) QMetaType::type(so->className());
+  if (type)
+    return asQVariantOfType(rvalue, type, false);
+  return qVariantFromValue(so->ptr());
+}
+
 QVariant qvariant_from_sexp(SEXP rvalue, int index) {
   QVariant variant;
   if (index == -1) {
@@ -396,25 +409,17 @@ QVariant qvariant_from_sexp(SEXP rvalue, int index) {
     // Rprintf("String\n");
     variant = QVariant(sexp2qstring(STRING_ELT(rvalue, index)));
     break;
-  case EXTPTRSXP:
-    // Rprintf("External pointer\n");
-    variant = qVariantFromValue(unwrapPointer(rvalue, void));
-    break;
   case VECSXP:
     variant = from_sexp<QVariant>(VECTOR_ELT(rvalue, index));
     break;
-  case ENVSXP: {
-    SmokeObject *so = SmokeObject::fromSexp(rvalue);
-    if (so->instanceOf("QObject"))
-      variant =
-        qVariantFromValue(reinterpret_cast<QObject *>(so->castPtr("QObject")));
-    else {
-      QMetaType::Type type = (QMetaType::Type) QMetaType::type(so->className());
-      if (type)
-        variant = asQVariantOfType(rvalue, type, false);
-      else variant = qVariantFromValue(so->ptr());
-    }
-  }
+  case EXTPTRSXP:
+    // Rprintf("External pointer\n");
+    if (SmokeObject::isHandle(rvalue))
+      variant = qvariant_from_object(rvalue);
+    else variant = qVariantFromValue(unwrapPointer(rvalue, void));
+    break;
+  case ENVSXP:
+    variant = qvariant_from_object(rvalue);
     break;
   case NILSXP: // invalid QVariant
     break;
@@ -823,8 +828,99 @@ SEXP to_sexp(QMarginsF margins) {
   rptr[3] = margins.right();
   return rmargins;
 }
+
+template<> QMarginsF from_sexp<QMarginsF>(SEXP m) {
+  double *rmargins = REAL(m);
+  return QMarginsF(rmargins[1], rmargins[2], rmargins[3], rmargins[0]);
+}
 #endif
 
+/* Unboxed values
+
+   Geometry queries return a new value on every call, and wrapping
+   each in a reference (a copy on the heap, a SmokeObject, an
+   environment, an object table and a finalizer) dominates the cost.
+   With options(qtbase.unbox = TRUE), methods instead return these
+   types by value, as R vectors laid out like the explicit coercions
+   above:
+
+     QPointF     double c(x, y)
+     QSizeF      double c(width, height)
+     QRectF      double 2x2 matrix, c(left, right, top, bottom)
+     QColor      integer 4x1 matrix, c(red, green, blue, alpha)
+     QTransform  double 3x3 matrix, as from as.matrix()
+     QMarginsF   double c(bottom, left, top, right)
+
+   The vector has the class c("<type>Value", "QtValue"), e.g.,
+   c("QPointFValue", "QtValue"). Methods accept these vectors for
+   arguments of the type. Only values and const references are
+   unboxed; pointers and non-const references still refer to the
+   C++ object.
+*/
+
+static const char * const unboxedTypeNames[] = {
+  NULL, "QPointF", "QSizeF", "QRectF", "QColor", "QTransform", "QMarginsF"
+};
+
+UnboxedType unboxedType(const SmokeType &type) {
+  if (type.elem() != Smoke::t_class)
+    return NotUnboxed;
+  const char *name = type.className();
+  for (int i = NotUnboxed + 1; i < UnboxedTypeCount; i++)
+    if (!strcmp(name, unboxedTypeNames[i]))
+      return static_cast<UnboxedType>(i);
+  return NotUnboxed;
+}
+
+UnboxedType unboxedType(SEXP sexp) {
+  if (!OBJECT(sexp) || !isVectorAtomic(sexp) || !inherits(sexp, "QtValue"))
+    return NotUnboxed;
+  const char *name = CHAR(STRING_ELT(getAttrib(sexp, R_ClassSymbol), 0));
+  for (int i = NotUnboxed + 1; i < UnboxedTypeCount; i++) {
+    int len = strlen(unboxedTypeNames[i]);
+    if (!strncmp(name, unboxedTypeNames[i], len) &&
+        !strcmp(name + len, "Value"))
+      return static_cast<UnboxedType>(i);
+  }
+  return NotUnboxed;
+}
+
+SEXP unboxedSexp(SEXP value, UnboxedType type) {
+  static SEXP classes[UnboxedTypeCount];
+  if (!classes[type]) {
+    SEXP cl = allocVector(STRSXP, 2);
+    PreservePool::preserve(cl);
+    SET_STRING_ELT(cl, 0, mkChar(QByteArray(unboxedTypeNames[type]) +
+                                 "Value"));
+    SET_STRING_ELT(cl, 1, mkChar("QtValue"));
+    markShared(cl);
+    classes[type] = cl;
+  }
+  PROTECT(value);
+  setAttrib(value, R_ClassSymbol, classes[type]);
+  UNPROTECT(1);
+  return value;
+}
+
+/* Arithmetic in R might have changed the storage mode */
+SEXP unboxedValue(SEXP sexp, UnboxedType type) {
+  static const int lengths[] = { 0, 2, 2, 4, 4, 9, 4 };
+  if (length(sexp) != lengths[type])
+    error("Expected %d values for an unboxed %s, not %d", lengths[type],
+          unboxedTypeNames[type], length(sexp));
+  return coerceVector(sexp, type == UnboxedQColor ? INTSXP : REALSXP);
+}
+
+bool unboxingEnabled() {
+  static SEXP option = install("qtbase.unbox");
+  return asLogical(GetOption1(option)) == TRUE;
+}
+
+bool handlesEnabled() {
+  static SEXP option = install("qtbase.handles");
+  return asLogical(GetOption1(option)) == TRUE;
+}
+
 #ifdef QT_TESTLIB_LIB
 DEF_COLLECTION_CONVERTERS(QList, QTestEvent*, ptr)
 SEXP to_sexp(QTestEventList eventList) {
@@ -3,6 +3,7 @@
 
 #include <QVariant>
 #include <QString>
+#include <QMargins>
 
 // low-level conversion (reference wrapping)
 #include "wrap.hpp" 
@@ -414,6 +415,34 @@ SEXP to_sexp(QTransform tform);
 template<> QColor from_sexp<QColor>(SEXP c); /* <-> 4x1 matrix */
 SEXP to_sexp(QColor color);
 
+#if QT_VERSION >= 0x50300
+template<> QMarginsF from_sexp<QMarginsF>(SEXP m); /* <-> 4-vector */
+SEXP to_sexp(QMarginsF margins);
+#endif
+
+/* Unboxed values: on request, a few value types are returned as
+   classed R vectors, rather than references (see convert.cpp) */
+
+enum UnboxedType {
+  NotUnboxed,
+  UnboxedQPointF,
+  UnboxedQSizeF,
+  UnboxedQRectF,
+  UnboxedQColor,
+  UnboxedQTransform,
+  UnboxedQMarginsF,
+  UnboxedTypeCount
+};
+
+UnboxedType unboxedType(const SmokeType &type);
+UnboxedType unboxedType(SEXP sexp);
+SEXP unboxedSexp(SEXP value, UnboxedType type); // adds the class
+SEXP unboxedValue(SEXP sexp, UnboxedType type); // checks and coerces
+bool unboxingEnabled();
+/* options(qtbase.handles = TRUE): return values as handles (see
+   SmokeObject::handleSexp()) */
+bool handlesEnabled();
+
 template<> QMap<QString,QVariant>
 from_sexp<QMap<QString,QVariant> >(SEXP sexp, const SmokeType &type);
 
@@ -0,0 +1,171 @@
+#include <QHash>
+#include <QObject>
+#include <QVector>
+
+#include "SmokeObject.hpp"
+#include "Class.hpp"
+#include "SmokeClass.hpp"
+#include "ObjectTable.hpp"
+#include "PreservePool.hpp"
+#include "DestructionQueue.hpp"
+
+#include <Rinternals.h>
+
+/* Internal statistics, for tuning and for finding leaks */
+
+enum {
+  INSTANCES_COUNT,
+  INSTANCES_CAPACITY,
+  INSTANCES_LOAD,
+  INSTANCES_LOOKUPS,
+  INSTANCES_MEAN_PROBES,
+  INSTANCES_MAX_PROBES,
+  INSTANCES_SLAB_RECORDS,
+  INSTANCES_SLAB_CAPACITY,
+  INSTANCES_LAST
+};
+
+static SEXP instanceDiagnostics() {
+  const PointerTable<SmokeObject> &table = SmokeObject::instanceTable();
+  SEXP ans = allocVector(REALSXP, INSTANCES_LAST);
+  REAL(ans)[INSTANCES_COUNT] = table.size();
+  REAL(ans)[INSTANCES_CAPACITY] = table.capacity();
+  REAL(ans)[INSTANCES_LOAD] = table.loadFactor();
+  REAL(ans)[INSTANCES_LOOKUPS] = table.lookups();
+  REAL(ans)[INSTANCES_MEAN_PROBES] = table.meanProbes();
+  REAL(ans)[INSTANCES_MAX_PROBES] = table.maxProbes();
+  REAL(ans)[INSTANCES_SLAB_RECORDS] = SmokeObject::slabRecords();
+  REAL(ans)[INSTANCES_SLAB_CAPACITY] = SmokeObject::slabCapacity();
+  return ans;
+}
+
+enum {
+  PRESERVED_COUNT,
+  PRESERVED_CAPACITY,
+  PRESERVED_LAST
+};
+
+static SEXP preservedDiagnostics() {
+  SEXP ans = allocVector(REALSXP, PRESERVED_LAST);
+  REAL(ans)[PRESERVED_COUNT] = PreservePool::size();
+  REAL(ans)[PRESERVED_CAPACITY] = PreservePool::capacity();
+  return ans;
+}
+
+enum {
+  DIAGNOSTICS_INSTANCES,
+  DIAGNOSTICS_PRESERVED,
+  DIAGNOSTICS_DESTRUCTION_QUEUE,
+  DIAGNOSTICS_LAST
+};
+
+extern "C"
+SEXP qt_qdiagnostics() {
+  SEXP ans;
+  PROTECT(ans = allocVector(VECSXP, DIAGNOSTICS_LAST));
+  SET_VECTOR_ELT(ans, DIAGNOSTICS_INSTANCES, instanceDiagnostics());
+  SET_VECTOR_ELT(ans, DIAGNOSTICS_PRESERVED, preservedDiagnostics());
+  SET_VECTOR_ELT(ans, DIAGNOSTICS_DESTRUCTION_QUEUE,
+                 ScalarReal(DestructionQueue::size()));
+  UNPROTECT(1);
+  return ans;
+}
+
+/* Counts the registered instances by class. Unallocated instances are
+   not registered, so they only appear in the totals. */
+
+struct ClassCensus {
+  const Class *klass;
+  int count;
+  int allocated;
+  int owned;
+  int parented;
+  int sexp;
+  int internal;
+  int field;
+};
+
+enum {
+  CENSUS_CLASS,
+  CENSUS_COUNT,
+  CENSUS_ALLOCATED,
+  CENSUS_OWNED,
+  CENSUS_PARENTED,
+  CENSUS_SEXP,
+  CENSUS_INTERNAL,
+  CENSUS_FIELD,
+  CENSUS_SIZE,
+  CENSUS_TOTALS,
+  CENSUS_LAST
+};
+
+enum {
+  TOTALS_INSTANCES,
+  TOTALS_UNREGISTERED,
+  TOTALS_ENVIRONMENTS,
+  TOTALS_TABLES,
+  TOTALS_PRESERVED,
+  TOTALS_LAST
+};
+
+extern "C"
+SEXP qt_qobjectCensus() {
+  const PointerTable<SmokeObject> &table = SmokeObject::instanceTable();
+  QHash<const Class *, int> rows;
+  QVector<ClassCensus> census;
+  for (int i = 0; i < table.capacity(); i++) {
+    SmokeObject *obj = table.valueAt(i);
+    if (!obj)
+      continue;
+    QHash<const Class *, int>::const_iterator row = rows.find(obj->klass());
+    if (row == rows.end()) {
+      ClassCensus entry = { obj->klass(), 0, 0, 0, 0, 0, 0, 0 };
+      row = rows.insert(obj->klass(), census.size());
+      census.append(entry);
+    }
+    ClassCensus &entry = census[row.value()];
+    entry.count++;
+    entry.allocated += obj->allocated();
+    entry.owned += obj->ownedByR(); // the census must not change anything
+    entry.parented += obj->instanceOf("QObject") &&
+      reinterpret_cast<QObject *>(obj->castPtr("QObject"))->parent();
+    entry.sexp += obj->hasSexp();
+    entry.internal += obj->internalSexpCount() > 0;
+    entry.field += obj->hasFieldEnv();
+  }
+
+  int n = census.size();
+  SEXP ans, className, size, totals;
+  PROTECT(ans = allocVector(VECSXP, CENSUS_LAST));
+  className = allocVector(STRSXP, n);
+  SET_VECTOR_ELT(ans, CENSUS_CLASS, className);
+  for (int column = CENSUS_COUNT; column < CENSUS_SIZE; column++)
+    SET_VECTOR_ELT(ans, column, allocVector(INTSXP, n));
+  size = allocVector(REALSXP, n);
+  SET_VECTOR_ELT(ans, CENSUS_SIZE, size);
+  for (int i = 0; i < n; i++) {
+    const ClassCensus &entry = census[i];
+    const SmokeClass *base = entry.klass->smokeBase();
+    SET_STRING_ELT(className, i, mkChar(entry.klass->name()));
+    INTEGER(VECTOR_ELT(ans, CENSUS_COUNT))[i] = entry.count;
+    INTEGER(VECTOR_ELT(ans, CENSUS_ALLOCATED))[i] = entry.allocated;
+    INTEGER(VECTOR_ELT(ans, CENSUS_OWNED))[i] = entry.owned;
+    INTEGER(VECTOR_ELT(ans, CENSUS_PARENTED))[i] = entry.parented;
+    INTEGER(VECTOR_ELT(ans, CENSUS_SEXP))[i] = entry.sexp;
+    INTEGER(VECTOR_ELT(ans, CENSUS_INTERNAL))[i] = entry.internal;
+    INTEGER(VECTOR_ELT(ans, CENSUS_FIELD))[i] = entry.field;
+    // the C++ size of the Smoke base, excluding any heap data
+    REAL(size)[i] = base->smoke()->classes[base->classId()].size;
+  }
+
+  totals = allocVector(REALSXP, TOTALS_LAST);
+  SET_VECTOR_ELT(ans, CENSUS_TOTALS, totals);
+  REAL(totals)[TOTALS_INSTANCES] = table.size();
+  REAL(totals)[TOTALS_UNREGISTERED] =
+    SmokeObject::slabRecords() - table.size();
+  REAL(totals)[TOTALS_ENVIRONMENTS] = SmokeObject::environmentCount();
+  REAL(totals)[TOTALS_TABLES] = ObjectTable::count();
+  REAL(totals)[TOTALS_PRESERVED] = PreservePool::size();
+  UNPROTECT(1);
+  return ans;
+}
@@ -21,6 +21,7 @@ extern "C" {
   // metadata
   SEXP qt_qmethods(SEXP klass);
   SEXP qt_qenums(SEXP klass);
+  SEXP qt_qenumValues(SEXP klass);
   SEXP qt_qproperties(SEXP x);
   SEXP qt_qclasses(SEXP rsmoke);
   SEXP qt_qparentClasses(SEXP klass);
@@ -38,11 +39,23 @@ extern "C" {
   // dynamic invocation
   SEXP qt_qinvoke(SEXP method, SEXP self, SEXP args);
   SEXP qt_qinvokeStatic(SEXP method, SEXP smoke, SEXP klass, SEXP args);
+  SEXP qt_qbind(SEXP x, SEXP method, SEXP types);
+  SEXP qt_qinvokeBound(SEXP bound, SEXP args);
+  SEXP qt_qinvokeBatch(SEXP targets, SEXP method, SEXP args);
+  SEXP qt_qinvokeStaticBatch(SEXP klass, SEXP method, SEXP args);
+
+  // profiling
+  SEXP qt_qprofile(SEXP enable, SEXP reset);
+  SEXP qt_qdiagnostics();
+  SEXP qt_qobjectCensus();
   
   // user classes
   SEXP qt_qcast(SEXP x, SEXP className);
   SEXP qt_qenclose(SEXP x, SEXP fun);
+  SEXP qt_qpromote(SEXP x);
   SEXP qt_qinitClass(SEXP x);
+  SEXP qt_qmethodChanged(SEXP name);
+  SEXP qt_qclassChanged();
 
   // Invoke a Smoke method with R types
   SEXP invokeSmokeMethod(Smoke *smoke, short index, SEXP x, SEXP args);
@@ -85,6 +98,7 @@ static R_CallMethodDef CallEntries[] = {
     // General metadata
     CALLDEF(qt_qmethods, 1),
     CALLDEF(qt_qenums, 1),
+    CALLDEF(qt_qenumValues, 1),
     CALLDEF(qt_qproperties, 1),
     CALLDEF(qt_qclasses, 1),
     CALLDEF(qt_qparentClasses, 1),
@@ -95,11 +109,23 @@ static R_CallMethodDef CallEntries[] = {
     // Dynamic invocation
     CALLDEF(qt_qinvoke, 4),
     CALLDEF(qt_qinvokeStatic, 3),
+    CALLDEF(qt_qbind, 3),
+    CALLDEF(qt_qinvokeBound, 2),
+    CALLDEF(qt_qinvokeBatch, 3),
+    CALLDEF(qt_qinvokeStaticBatch, 3),
+
+    // Profiling
+    CALLDEF(qt_qprofile, 2),
+    CALLDEF(qt_qdiagnostics, 0),
+    CALLDEF(qt_qobjectCensus, 0),
     
     // User classes
     CALLDEF(qt_qcast, 2),
     CALLDEF(qt_qenclose, 2),
+    CALLDEF(qt_qpromote, 1),
     CALLDEF(qt_qinitClass, 1),
+    CALLDEF(qt_qmethodChanged, 1),
+    CALLDEF(qt_qclassChanged, 0),
 
     // Explicit coercions
     CALLDEF_COERCE(QRectF),
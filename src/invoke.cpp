@@ -1,8 +1,10 @@
 /* experimental support for dynamic invocation of methods */
 
 #include "DynamicBinding.hpp"
+#include "BoundMethod.hpp"
 #include "Class.hpp"
 #include "SmokeMethod.hpp"
+#include "SmokeObject.hpp"
 
 #include <Rinternals.h>
 
@@ -31,6 +33,146 @@ SEXP qt_qinvokeStatic(SEXP rklass, SEXP method, SEXP args) {
   return ans;
 }
 
+/* Resolve a method once, for repeated invocation */
+extern "C"
+SEXP qt_qbind(SEXP x, SEXP method, SEXP types) {
+  const char * methodName = CHAR(asChar(method));
+  BoundMethod *bound;
+  if (isEnvironment(x) || SmokeObject::isHandle(x))
+    bound = new BoundMethod(x, methodName);
+  else bound = new BoundMethod(Class::fromSexp(x), methodName);
+  SEXP ans = PROTECT(bound->sexp()); // finalizes the binding upon error
+  if (types != R_NilValue) {
+    QList<QByteArray> typeNames;
+    for (int i = 0; i < length(types); i++)
+      typeNames << CHAR(STRING_ELT(types, i));
+    if (!bound->select(typeNames))
+      error("Could not find method '%s::%s' with the given types",
+            bound->klass()->name(), methodName);
+  }
+  UNPROTECT(1);
+  return ans;
+}
+
+extern "C"
+SEXP qt_qinvokeBound(SEXP rbound, SEXP args) {
+  BoundMethod *bound = BoundMethod::fromSexp(rbound);
+  SEXP ans = bound->invoke(args);
+  if (bound->lastError() > Method::NoError)
+    reportMethodError(*bound, bound->klass()->name());
+  return ans;
+}
+
+/* Batch invocation */
+
+/* Element 'i' of an argument column, as a length-one vector */
+static SEXP batchElement(SEXP column, int i) {
+  SEXP elt;
+  switch(TYPEOF(column)) {
+  case VECSXP:
+    return VECTOR_ELT(column, i);
+  case REALSXP:
+    elt = ScalarReal(REAL(column)[i]);
+    break;
+  case INTSXP:
+    elt = ScalarInteger(INTEGER(column)[i]);
+    break;
+  case LGLSXP:
+    elt = ScalarLogical(LOGICAL(column)[i]);
+    break;
+  case STRSXP:
+    elt = ScalarString(STRING_ELT(column, i));
+    break;
+  case RAWSXP:
+    elt = ScalarRaw(RAW(column)[i]);
+    break;
+  case CPLXSXP:
+    elt = allocVector(CPLXSXP, 1);
+    COMPLEX(elt)[0] = COMPLEX(column)[i];
+    break;
+  default:
+    error("Cannot take arguments from a vector of type '%s'",
+          type2char(TYPEOF(column)));
+  }
+  if (OBJECT(column)) { // e.g., QtEnum
+    PROTECT(elt);
+    setAttrib(elt, R_ClassSymbol, getAttrib(column, R_ClassSymbol));
+    UNPROTECT(1);
+  }
+  return elt;
+}
+
+/* Calls the bound method once for each target (if 'targets' is a
+   list) and each row of the argument columns in 'args'. Targets and
+   columns of length one are recycled. The overload is resolved by the
+   first call. */
+static SEXP invokeBatch(BoundMethod &bound, SEXP targets, SEXP args) {
+  int ntargets = isNull(targets) ? 1 : length(targets);
+  int ncols = length(args);
+  int n = ntargets;
+  for (int j = 0; j < ncols; j++)
+    n = qMax(n, length(VECTOR_ELT(args, j)));
+  if (ntargets == 0)
+    n = 0;
+  for (int j = 0; j < ncols; j++) {
+    int len = length(VECTOR_ELT(args, j));
+    if (len == 0)
+      n = 0;
+    else if (len != 1 && len != n)
+      error("Argument %d has length %d, expected 1 or %d", j+1, len, n);
+  }
+  if (ntargets != 1 && ntargets != n)
+    error("Have %d objects, expected 1 or %d", ntargets, n);
+
+  SEXP ans, callArgs;
+  PROTECT(ans = allocVector(VECSXP, n));
+  PROTECT(callArgs = allocVector(VECSXP, ncols));
+  for (int i = 0; i < n; i++) {
+    SEXP target = NULL;
+    if (!isNull(targets)) {
+      target = VECTOR_ELT(targets, ntargets == 1 ? 0 : i);
+      if (!bound.appliesTo(SmokeObject::fromSexp(target)))
+        error("Object %d is not an instance of '%s'", i+1,
+              bound.klass()->name());
+    }
+    for (int j = 0; j < ncols; j++) {
+      SEXP column = VECTOR_ELT(args, j);
+      int row = length(column) == 1 ? 0 : i;
+      SET_VECTOR_ELT(callArgs, j, batchElement(column, row));
+    }
+    SEXP value = bound.invoke(target, callArgs);
+    if (bound.lastError() > Method::NoError)
+      reportMethodError(bound, bound.klass()->name());
+    if (value)
+      SET_VECTOR_ELT(ans, i, value);
+  }
+  UNPROTECT(2);
+  return ans;
+}
+
+extern "C"
+SEXP qt_qinvokeBatch(SEXP targets, SEXP method, SEXP args) {
+  if (!length(targets))
+    return allocVector(VECSXP, 0);
+  /* The pointer finalizes the binding if an error jumps out */
+  BoundMethod *bound = new BoundMethod(VECTOR_ELT(targets, 0),
+                                       CHAR(asChar(method)));
+  PROTECT(bound->sexp());
+  SEXP ans = invokeBatch(*bound, targets, args);
+  UNPROTECT(1);
+  return ans;
+}
+
+extern "C"
+SEXP qt_qinvokeStaticBatch(SEXP rklass, SEXP method, SEXP args) {
+  BoundMethod *bound = new BoundMethod(Class::fromSexp(rklass),
+                                       CHAR(asChar(method)));
+  PROTECT(bound->sexp());
+  SEXP ans = invokeBatch(*bound, R_NilValue, args);
+  UNPROTECT(1);
+  return ans;
+}
+
 extern "C" SEXP invokeSmokeMethod(Smoke *smoke, short index, SEXP x, SEXP args)
 {
   SmokeMethod method(smoke, index);
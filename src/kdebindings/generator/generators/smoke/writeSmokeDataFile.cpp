@@ -759,6 +759,7 @@ void SmokeDataFile::write()
        every qtbase-derived package. */
     if (Options::parentModules.isEmpty()) {
         out << "Smoke::ClassMap Smoke::classMap;\n\n";
+        out << "Smoke::ClassIndex Smoke::classIndex;\n\n";
         out << "Smoke::ModuleIndex Smoke::NullModuleIndex;\n\n";
     }
     
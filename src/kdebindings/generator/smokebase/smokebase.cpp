@@ -3,4 +3,5 @@
 #include <smoke.h>
 
 Smoke::ClassMap Smoke::classMap;
+Smoke::ClassIndex Smoke::classIndex;
 Smoke::ModuleIndex Smoke::NullModuleIndex;
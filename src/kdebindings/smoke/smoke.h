@@ -113,6 +113,39 @@ public:
     typedef std::map<std::string, ModuleIndex> ClassMap;
     static ClassMap classMap;
 
+    /**
+     * ML: A slot in an open-addressing hash index. The name is
+     * borrowed from the module data, and the hash is compared before
+     * the name, so a probe rarely touches the string. Index 0 marks
+     * an empty slot, as the Smoke tables start at 1.
+     */
+    struct IndexSlot {
+        const char *name;
+        unsigned int hash;
+        ModuleIndex value;
+    };
+    /**
+     * ML: The classes of all modules by name, like classMap, but
+     * probed directly with a C string. It is plain data, so that it
+     * is ready before any module registers.
+     */
+    struct ClassIndex {
+        IndexSlot *slots;
+        unsigned int mask;
+        unsigned int size;
+    };
+    static ClassIndex classIndex;
+
+    /**
+     * FNV-1a; names are short.
+     */
+    static inline unsigned int hashName(const char *name) {
+        unsigned int h = 2166136261u;
+        for (; *name; name++)
+            h = (h ^ (unsigned char)*name) * 16777619u;
+        return h;
+    }
+
     enum ClassFlags {
         cf_constructor = 0x01,  // has a constructor
         cf_deepcopy = 0x02,     // has copy constructor
@@ -290,6 +323,120 @@ public:
      */
     CastFn castFn;
 
+private:
+    /**
+     * ML: Hash indices over the sorted tables, built by the
+     * constructor. The binary searches compare strings at every step,
+     * and the tables hold tens of thousands of entries.
+     */
+    IndexSlot *typeIndex;
+    IndexSlot *classNameIndex;
+    IndexSlot *methodNameIndex;
+    IndexSlot *methodMapIndex; // keyed by (classId, name)
+    unsigned int typeMask, classNameMask, methodNameMask, methodMapMask;
+
+    static inline IndexSlot *createIndex(Index n, unsigned int &mask) {
+        unsigned int capacity = 2;
+        while (capacity < 2 * (unsigned int)n)
+            capacity *= 2;
+        mask = capacity - 1;
+        return new IndexSlot[capacity]();
+    }
+
+    static inline void insertIndex(IndexSlot *slots, unsigned int mask,
+                                   const char *name, unsigned int hash,
+                                   const ModuleIndex &value) {
+        unsigned int i = hash & mask;
+        while (slots[i].value.index) {
+            if (slots[i].hash == hash && slots[i].name &&
+                !strcmp(slots[i].name, name))
+                return; // keep the first, as there is no order to search
+            i = (i + 1) & mask;
+        }
+        slots[i].name = name;
+        slots[i].hash = hash;
+        slots[i].value = value;
+    }
+
+    static inline const IndexSlot *lookupIndex(const IndexSlot *slots,
+                                               unsigned int mask,
+                                               const char *name) {
+        if (!slots || !name)
+            return 0;
+        unsigned int hash = hashName(name);
+        for (unsigned int i = hash & mask; slots[i].value.index;
+             i = (i + 1) & mask) {
+            if (slots[i].hash == hash && !strcmp(slots[i].name, name))
+                return &slots[i];
+        }
+        return 0;
+    }
+
+    static inline unsigned int hashMethodMap(Index c, Index name) {
+        unsigned long long h = ((unsigned long long)c << 32) ^ name;
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        return (unsigned int)h;
+    }
+
+    static inline void registerClass(const char *name, const ModuleIndex &mi) {
+        ClassIndex &index = classIndex;
+        if ((index.size + 1) * 10 > (index.slots ? index.mask + 1 : 0) * 7) {
+            IndexSlot *old = index.slots;
+            unsigned int oldCapacity = old ? index.mask + 1 : 0;
+            index.slots = createIndex(oldCapacity ? oldCapacity : 512,
+                                      index.mask);
+            index.size = 0;
+            for (unsigned int i = 0; i < oldCapacity; i++)
+                if (old[i].value.index)
+                    registerClass(old[i].name, old[i].value);
+            delete[] old;
+        }
+        unsigned int hash = hashName(name);
+        unsigned int i = hash & index.mask;
+        for (; index.slots[i].value.index; i = (i + 1) & index.mask) {
+            if (index.slots[i].hash == hash &&
+                !strcmp(index.slots[i].name, name))
+                break; // a later module overrides, as in classMap
+        }
+        if (!index.slots[i].value.index)
+            index.size++;
+        index.slots[i].name = name;
+        index.slots[i].hash = hash;
+        index.slots[i].value = mi;
+    }
+
+    inline void buildIndices() {
+        typeIndex = createIndex(numTypes, typeMask);
+        for (Index i = 1; i <= numTypes; ++i)
+            if (types[i].name)
+                insertIndex(typeIndex, typeMask, types[i].name,
+                            hashName(types[i].name), ModuleIndex(this, i));
+        classNameIndex = createIndex(numClasses, classNameMask);
+        for (Index i = 1; i <= numClasses; ++i)
+            if (classes[i].className)
+                insertIndex(classNameIndex, classNameMask, classes[i].className,
+                            hashName(classes[i].className),
+                            ModuleIndex(this, i));
+        methodNameIndex = createIndex(numMethodNames, methodNameMask);
+        for (Index i = 1; i <= numMethodNames; ++i)
+            if (methodNames[i])
+                insertIndex(methodNameIndex, methodNameMask, methodNames[i],
+                            hashName(methodNames[i]), ModuleIndex(this, i));
+        methodMapIndex = createIndex(numMethodMaps, methodMapMask);
+        for (Index i = 1; i <= numMethodMaps; ++i) {
+            unsigned int hash = hashMethodMap(methodMaps[i].classId,
+                                              methodMaps[i].name);
+            unsigned int j = hash & methodMapMask;
+            while (methodMapIndex[j].value.index)
+                j = (j + 1) & methodMapMask;
+            methodMapIndex[j].hash = hash;
+            methodMapIndex[j].value = ModuleIndex(this, i);
+        }
+    }
+
+public:
     /**
      * Constructor
      */
@@ -317,10 +464,25 @@ public:
             for (Index i = 1; i <= numClasses; ++i) {
                 if (!classes[i].external) {
                     classMap[className(i)] = ModuleIndex(this, i);
+                    registerClass(className(i), ModuleIndex(this, i));
                 }
             }
+            buildIndices();
         }
 
+    ~Smoke() {
+        delete[] typeIndex;
+        delete[] classNameIndex;
+        delete[] methodNameIndex;
+        delete[] methodMapIndex;
+    }
+
+private:
+    Smoke(const Smoke &); // owns the indices
+    Smoke &operator=(const Smoke &);
+
+public:
+
     /**
      * Returns the name of the module (e.g. "qt" or "kde")
      */
@@ -357,85 +519,26 @@ public:
     }
 
     inline Index idType(const char *t) {
-        Index imax = numTypes;
-        Index imin = 1;
-        Index icur = -1;
-        int icmp = -1;
-
-        while (imax >= imin) {
-            icur = (imin + imax) / 2;
-            icmp = strcmp(types[icur].name, t);
-            if (icmp == 0) {
-                return icur;
-            }
-
-            if (icmp > 0) {
-                imax = icur - 1;
-            } else {
-                imin = icur + 1;
-            }
-        }
-
-        return 0;
+        const IndexSlot *slot = lookupIndex(typeIndex, typeMask, t);
+        return slot ? slot->value.index : 0;
     }
 
     inline ModuleIndex idClass(const char *c, bool external = false) {
-        Index imax = numClasses;
-        Index imin = 1;
-        Index icur = -1;
-        int icmp = -1;
-
-        while (imax >= imin) {
-            icur = (imin + imax) / 2;
-            icmp = strcmp(classes[icur].className, c);
-            if (icmp == 0) {
-                if (classes[icur].external && !external) {
-                    return NullModuleIndex;
-                } else {
-                    return ModuleIndex(this, icur);
-                }
-            }
-
-            if (icmp > 0) {
-                imax = icur - 1;
-            } else {
-                imin = icur + 1;
-            }
-        }
-
-        return NullModuleIndex;
+        const IndexSlot *slot = lookupIndex(classNameIndex, classNameMask, c);
+        if (!slot || (classes[slot->value.index].external && !external))
+            return NullModuleIndex;
+        return slot->value;
     }
 
     static inline ModuleIndex findClass(const char *c) {
-        ClassMap::iterator i = classMap.find(c);
-        if (i == classMap.end()) {
-            return NullModuleIndex;
-        } else {
-            return i->second;
-        }
+        const IndexSlot *slot = lookupIndex(classIndex.slots, classIndex.mask,
+                                            c);
+        return slot ? slot->value : NullModuleIndex;
     }
 
     inline ModuleIndex idMethodName(const char *m) {
-        Index imax = numMethodNames;
-        Index imin = 1;
-        Index icur = -1;
-        int icmp = -1;
-
-        while (imax >= imin) {
-            icur = (imin + imax) / 2;
-            icmp = strcmp(methodNames[icur], m);
-            if (icmp == 0) {
-                return ModuleIndex(this, icur);
-            }
-
-            if (icmp > 0) {
-                imax = icur - 1;
-            } else {
-                imin = icur + 1;
-            }
-        }
-
-        return NullModuleIndex;
+        const IndexSlot *slot = lookupIndex(methodNameIndex, methodNameMask, m);
+        return slot ? slot->value : NullModuleIndex;
     }
 
     inline ModuleIndex findMethodName(const char *c, const char *m) {
@@ -450,7 +553,7 @@ public:
 	    for (Index p = classes[cmi.index].parents; inheritanceList[p]; p++) {
 		Index ci = inheritanceList[p];
 		const char* cName = className(ci);
-		ModuleIndex mi = classMap[cName].smoke->findMethodName(cName, m);
+		ModuleIndex mi = findClass(cName).smoke->findMethodName(cName, m);
 		if (mi.index) return mi;
 	    }
 	}
@@ -458,28 +561,15 @@ public:
     }
 
     inline ModuleIndex idMethod(Index c, Index name) {
-        Index imax = numMethodMaps;
-        Index imin = 1;
-        Index icur = -1;
-        int icmp = -1;
-
-        while (imax >= imin) {
-            icur = (imin + imax) / 2;
-            icmp = leg(methodMaps[icur].classId, c);
-            if (icmp == 0) {
-                icmp = leg(methodMaps[icur].name, name);
-                if (icmp == 0) {
-                    return ModuleIndex(this, icur);
-                }
-            }
-
-            if (icmp > 0) {
-                imax = icur - 1;
-            } else {
-                imin = icur + 1;
-            }
+        unsigned int hash = hashMethodMap(c, name);
+        for (unsigned int i = hash & methodMapMask; methodMapIndex[i].value.index;
+             i = (i + 1) & methodMapMask) {
+            const IndexSlot &slot = methodMapIndex[i];
+            if (slot.hash == hash &&
+                methodMaps[slot.value.index].classId == c &&
+                methodMaps[slot.value.index].name == name)
+                return slot.value;
         }
-
         return NullModuleIndex;
     }
 
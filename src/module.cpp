@@ -13,12 +13,269 @@
 #include "SmokeModule.hpp"
 #include "SmokeObject.hpp"
 #include "Class.hpp"
+#include "MocClass.hpp"
 
 // FIXME: These functions take a 'SmokeObject', which is not (yet)
 // available to packages, so packages cannot override these in their
 // modules. Either need to (1) provide C-level SmokeObject bindings,
 // or (2) the signature should become smoke, classId and void ptr.
 
+/* The class of each type of QEvent, or NULL if the type is unknown */
+static const char *eventClassName(int type) {
+  switch (type) {
+  case QEvent::Timer:
+    return "QTimerEvent";
+  case QEvent::MouseButtonPress:
+  case QEvent::MouseButtonRelease:
+  case QEvent::MouseButtonDblClick:
+  case QEvent::MouseMove:
+    return "QMouseEvent";
+  case QEvent::KeyPress:
+  case QEvent::KeyRelease:
+  case QEvent::ShortcutOverride:
+    return "QKeyEvent";
+  case QEvent::FocusIn:
+  case QEvent::FocusOut:
+    return "QFocusEvent";
+  case QEvent::Enter:
+  case QEvent::Leave:
+    return "QEvent";
+  case QEvent::Paint:
+    return "QPaintEvent";
+  case QEvent::Move:
+    return "QMoveEvent";
+  case QEvent::Resize:
+    return "QResizeEvent";
+  case QEvent::Create:
+  case QEvent::Destroy:
+    return "QEvent";
+  case QEvent::Show:
+    return "QShowEvent";
+  case QEvent::Hide:
+    return "QHideEvent";
+  case QEvent::Close:
+    return "QCloseEvent";
+  case QEvent::Quit:
+  case QEvent::ParentChange:
+  case QEvent::ParentAboutToChange:
+  case QEvent::ThreadChange:
+  case QEvent::WindowActivate:
+  case QEvent::WindowDeactivate:
+  case QEvent::ShowToParent:
+  case QEvent::HideToParent:
+    return "QEvent";
+  case QEvent::Wheel:
+    return "QWheelEvent";
+  case QEvent::WindowTitleChange:
+  case QEvent::WindowIconChange:
+  case QEvent::ApplicationWindowIconChange:
+  case QEvent::ApplicationFontChange:
+  case QEvent::ApplicationLayoutDirectionChange:
+  case QEvent::ApplicationPaletteChange:
+  case QEvent::PaletteChange:
+    return "QEvent";
+  case QEvent::Clipboard:
+    return "QClipboardEvent";
+  case QEvent::Speech:
+  case QEvent::MetaCall:
+  case QEvent::SockAct:
+  case QEvent::WinEventAct:
+  case QEvent::DeferredDelete:
+    return "QEvent";
+  case QEvent::DragEnter:
+    return "QDragEnterEvent";
+  case QEvent::DragLeave:
+    return "QDragLeaveEvent";
+  case QEvent::DragMove:
+    return "QDragMoveEvent";
+  case QEvent::Drop:
+    return "QDropEvent";
+  case QEvent::DragResponse:
+    return "QDragResponseEvent";
+  case QEvent::ChildAdded:
+  case QEvent::ChildRemoved:
+  case QEvent::ChildPolished:
+    return "QChildEvent";
+  case QEvent::ShowWindowRequest:
+  case QEvent::PolishRequest:
+  case QEvent::Polish:
+  case QEvent::LayoutRequest:
+  case QEvent::UpdateRequest:
+  case QEvent::EmbeddingControl:
+  case QEvent::ActivateControl:
+  case QEvent::DeactivateControl:
+    return "QEvent";
+  case QEvent::ContextMenu:
+    return "QContextMenuEvent";
+  case QEvent::InputMethod:
+    return "QInputMethodEvent";
+  case QEvent::TabletMove:
+  case QEvent::TabletPress:
+  case QEvent::TabletRelease:
+    return "QTabletEvent";
+  case QEvent::LocaleChange:
+  case QEvent::LanguageChange:
+  case QEvent::LayoutDirectionChange:
+  case QEvent::Style:
+  case QEvent::OkRequest:
+  case QEvent::HelpRequest:
+    return "QEvent";
+  case QEvent::IconDrag:
+    return "QIconDragEvent";
+  case QEvent::FontChange:
+  case QEvent::EnabledChange:
+  case QEvent::ActivationChange:
+  case QEvent::StyleChange:
+  case QEvent::IconTextChange:
+  case QEvent::ModifiedChange:
+  case QEvent::MouseTrackingChange:
+    return "QEvent";
+  case QEvent::WindowBlocked:
+  case QEvent::WindowUnblocked:
+  case QEvent::WindowStateChange:
+    return "QWindowStateChangeEvent";
+  case QEvent::ToolTip:
+  case QEvent::WhatsThis:
+    return "QHelpEvent";
+  case QEvent::StatusTip:
+    return "QEvent";
+  case QEvent::ActionChanged:
+  case QEvent::ActionAdded:
+  case QEvent::ActionRemoved:
+    return "QActionEvent";
+  case QEvent::FileOpen:
+    return "QFileOpenEvent";
+  case QEvent::Shortcut:
+    return "QShortcutEvent";
+  case QEvent::WhatsThisClicked:
+    return "QWhatsThisClickedEvent";
+  case QEvent::ToolBarChange:
+    return "QToolBarChangeEvent";
+  case QEvent::ApplicationActivated:
+  case QEvent::ApplicationDeactivated:
+  case QEvent::QueryWhatsThis:
+  case QEvent::EnterWhatsThisMode:
+  case QEvent::LeaveWhatsThisMode:
+  case QEvent::ZOrderChange:
+    return "QEvent";
+  case QEvent::HoverEnter:
+  case QEvent::HoverLeave:
+  case QEvent::HoverMove:
+    return "QHoverEvent";
+  case QEvent::GraphicsSceneMouseMove:
+  case QEvent::GraphicsSceneMousePress:
+  case QEvent::GraphicsSceneMouseRelease:
+  case QEvent::GraphicsSceneMouseDoubleClick:
+    return "QGraphicsSceneMouseEvent";
+  case QEvent::GraphicsSceneContextMenu:
+    return "QGraphicsSceneContextMenuEvent";
+  case QEvent::GraphicsSceneHoverEnter:
+  case QEvent::GraphicsSceneHoverMove:
+  case QEvent::GraphicsSceneHoverLeave:
+    return "QGraphicsSceneHoverEvent";
+  case QEvent::GraphicsSceneHelp:
+    return "QGraphicsSceneHelpEvent";
+  case QEvent::GraphicsSceneDragEnter:
+  case QEvent::GraphicsSceneDragMove:
+  case QEvent::GraphicsSceneDragLeave:
+  case QEvent::GraphicsSceneDrop:
+    return "QGraphicsSceneDragDropEvent";
+  case QEvent::GraphicsSceneWheel:
+    return "QGraphicsSceneWheelEvent";
+  case QEvent::KeyboardLayoutChange:
+    return "QEvent";
+  case QEvent::TouchEnd:
+  case QEvent::TouchCancel:
+  case QEvent::TouchBegin:
+  case QEvent::TouchUpdate:
+    return "QTouchEvent";
+  case QEvent::Gesture:
+  case QEvent::GestureOverride:
+    return "QGestureEvent";
+  case QEvent::InputMethodQuery:
+    return "QInputMethodQueryEvent";
+  case QEvent::ScrollPrepare:
+    return "QScrollPrepareEvent";
+  case QEvent::Scroll:
+    return "QScrollEvent";
+  default:
+    return NULL;
+  }
+}
+
+/* Tables that spare resolve_classname_qt() from searching the Smoke
+   class names: the class of each QEvent type, built when the module
+   is registered, and the class of each QMetaObject, filled as they
+   are encountered. Only the static QMetaObjects of Smoke classes are
+   keys; those we create for R classes are freed with the class, and
+   another could take the same address. */
+struct ClassResolver {
+  Smoke::Index eventClass; // QEvent
+  QVector<Smoke::Index> eventClasses; // by QEvent::Type, -1 for no change
+  QHash<const QMetaObject *, Smoke::Index> metaClasses;
+};
+
+static QHash<Smoke *, ClassResolver *> resolvers;
+static Smoke *lastSmoke = NULL;
+static ClassResolver *lastResolver = NULL;
+
+static ClassResolver *resolver(Smoke *smoke) {
+  if (smoke != lastSmoke) {
+    lastResolver = resolvers.value(smoke);
+    lastSmoke = smoke;
+  }
+  return lastResolver;
+}
+
+static void createResolver(Smoke *smoke) {
+  ClassResolver *resolver = new ClassResolver;
+  resolver->eventClass = smoke->idClass("QEvent").index;
+  resolver->eventClasses.fill(-1, QEvent::User);
+  for (int type = 0; type < QEvent::User; type++) {
+    const char *name = eventClassName(type);
+    if (name)
+      resolver->eventClasses[type] = smoke->idClass(name).index;
+  }
+  delete resolvers.value(smoke);
+  resolvers.insert(smoke, resolver);
+  lastSmoke = NULL;
+}
+
+static Smoke::Index eventClass(Smoke *smoke, int type, Smoke::Index classId) {
+  ClassResolver *r = resolver(smoke);
+  Smoke::Index eventClassId = -1;
+  if (r) {
+    if (type >= 0 && type < r->eventClasses.size())
+      eventClassId = r->eventClasses[type];
+  } else {
+    const char *name = eventClassName(type);
+    if (name)
+      eventClassId = smoke->idClass(name).index;
+  }
+  return eventClassId < 0 ? classId : eventClassId;
+}
+
+/* The nearest class with Smoke bindings, as the QObject could be of a
+   private subclass */
+static Smoke::Index metaClass(Smoke *smoke, const QMetaObject *meta) {
+  ClassResolver *r = resolver(smoke);
+  if (r) {
+    QHash<const QMetaObject *, Smoke::Index>::const_iterator it =
+      r->metaClasses.constFind(meta);
+    if (it != r->metaClasses.constEnd())
+      return it.value();
+  }
+  Smoke::Index classId = smoke->idClass(meta->className()).index;
+  if (classId) {
+    if (r && MocClass(Class::fromSmokeId(smoke, classId)).metaObject() == meta)
+      r->metaClasses.insert(meta, classId);
+    return classId;
+  }
+  for (const QMetaObject *m = meta->superClass(); !classId; m = m->superClass())
+    classId = smoke->idClass(m->className()).index;
+  return classId;
+}
+
 /*
  * Given an approximate classname and a qt instance, try to improve
  * the resolution of the name by using the various Qt rtti mechanisms
@@ -29,251 +286,15 @@ resolve_classname_qt(const SmokeObject * o)
 {
   int classId = o->classId();
   Smoke *smoke = o->smoke();
-  const char *className = smoke->classes[classId].className;
-  if (smoke->isDerivedFrom(className, "QObject")) {
+  if (SmokeModule::isDerivedFrom(smoke, classId, "QObject")) {
     QObject *obj = (QObject *)o->castPtr("QObject");
-    int smokeClassId = 0;
-    const QMetaObject *meta = obj->metaObject();
-    while (!smokeClassId) {  // could be a private subclass
-      smokeClassId = smoke->idClass(meta->className()).index;
-      meta = meta->superClass();
-    }
-    classId = smokeClassId;
-  } else if (smoke->isDerivedFrom(className, "QEvent")) {
-    QEvent * qevent = (QEvent *)
-      smoke->cast(o->ptr(), classId, smoke->idClass("QEvent").index);
-    switch (qevent->type()) {
-    case QEvent::Timer:
-      classId = smoke->idClass("QTimerEvent").index;
-      break;
-    case QEvent::MouseButtonPress:
-    case QEvent::MouseButtonRelease:
-    case QEvent::MouseButtonDblClick:
-    case QEvent::MouseMove:
-      classId = smoke->idClass("QMouseEvent").index;
-      break;
-    case QEvent::KeyPress:
-    case QEvent::KeyRelease:
-    case QEvent::ShortcutOverride:
-      classId = smoke->idClass("QKeyEvent").index;
-      break;
-    case QEvent::FocusIn:
-    case QEvent::FocusOut:
-      classId = smoke->idClass("QFocusEvent").index;
-      break;
-    case QEvent::Enter:
-    case QEvent::Leave:
-      classId = smoke->idClass("QEvent").index;
-      break;
-    case QEvent::Paint:
-      classId = smoke->idClass("QPaintEvent").index;
-      break;
-    case QEvent::Move:
-      classId = smoke->idClass("QMoveEvent").index;
-      break;
-    case QEvent::Resize:
-      classId = smoke->idClass("QResizeEvent").index;
-      break;
-    case QEvent::Create:
-    case QEvent::Destroy:
-      classId = smoke->idClass("QEvent").index;
-      break;
-    case QEvent::Show:
-      classId = smoke->idClass("QShowEvent").index;
-      break;
-    case QEvent::Hide:
-      classId = smoke->idClass("QHideEvent").index;
-      break;
-    case QEvent::Close:
-      classId = smoke->idClass("QCloseEvent").index;
-      break;
-    case QEvent::Quit:
-    case QEvent::ParentChange:
-    case QEvent::ParentAboutToChange:
-    case QEvent::ThreadChange:
-    case QEvent::WindowActivate:
-    case QEvent::WindowDeactivate:
-    case QEvent::ShowToParent:
-    case QEvent::HideToParent:
-      classId = smoke->idClass("QEvent").index;
-      break;
-    case QEvent::Wheel:
-      classId = smoke->idClass("QWheelEvent").index;
-      break;
-    case QEvent::WindowTitleChange:
-    case QEvent::WindowIconChange:
-    case QEvent::ApplicationWindowIconChange:
-    case QEvent::ApplicationFontChange:
-    case QEvent::ApplicationLayoutDirectionChange:
-    case QEvent::ApplicationPaletteChange:
-    case QEvent::PaletteChange:
-      classId = smoke->idClass("QEvent").index;
-      break;
-    case QEvent::Clipboard:
-      classId = smoke->idClass("QClipboardEvent").index;
-      break;
-    case QEvent::Speech:
-    case QEvent::MetaCall:
-    case QEvent::SockAct:
-    case QEvent::WinEventAct:
-    case QEvent::DeferredDelete:
-      classId = smoke->idClass("QEvent").index;
-      break;
-    case QEvent::DragEnter:
-      classId = smoke->idClass("QDragEnterEvent").index;
-      break;
-    case QEvent::DragLeave:
-      classId = smoke->idClass("QDragLeaveEvent").index;
-      break;
-    case QEvent::DragMove:
-      classId = smoke->idClass("QDragMoveEvent").index;
-      break;
-    case QEvent::Drop:
-      classId = smoke->idClass("QDropEvent").index;
-      break;
-    case QEvent::DragResponse:
-      classId = smoke->idClass("QDragResponseEvent").index;
-      break;
-    case QEvent::ChildAdded:
-    case QEvent::ChildRemoved:
-    case QEvent::ChildPolished:
-      classId = smoke->idClass("QChildEvent").index;
-      break;
-    case QEvent::ShowWindowRequest:
-    case QEvent::PolishRequest:
-    case QEvent::Polish:
-    case QEvent::LayoutRequest:
-    case QEvent::UpdateRequest:
-    case QEvent::EmbeddingControl:
-    case QEvent::ActivateControl:
-    case QEvent::DeactivateControl:
-      classId = smoke->idClass("QEvent").index;
-      break;
-    case QEvent::ContextMenu:
-      classId = smoke->idClass("QContextMenuEvent").index;
-      break;
-    case QEvent::InputMethod:
-      classId = smoke->idClass("QInputMethodEvent").index;
-      break;
-    case QEvent::TabletMove:
-    case QEvent::TabletPress:
-    case QEvent::TabletRelease:
-      classId = smoke->idClass("QTabletEvent").index;
-      break;
-    case QEvent::LocaleChange:
-    case QEvent::LanguageChange:
-    case QEvent::LayoutDirectionChange:
-    case QEvent::Style:
-    case QEvent::OkRequest:
-    case QEvent::HelpRequest:
-      classId = smoke->idClass("QEvent").index;
-      break;
-    case QEvent::IconDrag:
-      classId = smoke->idClass("QIconDragEvent").index;
-      break;
-    case QEvent::FontChange:
-    case QEvent::EnabledChange:
-    case QEvent::ActivationChange:
-    case QEvent::StyleChange:
-    case QEvent::IconTextChange:
-    case QEvent::ModifiedChange:
-    case QEvent::MouseTrackingChange:
-      classId = smoke->idClass("QEvent").index;
-      break;
-    case QEvent::WindowBlocked:
-    case QEvent::WindowUnblocked:
-    case QEvent::WindowStateChange:
-      classId = smoke->idClass("QWindowStateChangeEvent").index;
-      break;
-    case QEvent::ToolTip:
-    case QEvent::WhatsThis:
-      classId = smoke->idClass("QHelpEvent").index;
-      break;
-    case QEvent::StatusTip:
-      classId = smoke->idClass("QEvent").index;
-      break;
-    case QEvent::ActionChanged:
-    case QEvent::ActionAdded:
-    case QEvent::ActionRemoved:
-      classId = smoke->idClass("QActionEvent").index;
-      break;
-    case QEvent::FileOpen:
-      classId = smoke->idClass("QFileOpenEvent").index;
-      break;
-    case QEvent::Shortcut:
-      classId = smoke->idClass("QShortcutEvent").index;
-      break;
-    case QEvent::WhatsThisClicked:
-      classId = smoke->idClass("QWhatsThisClickedEvent").index;
-      break;
-    case QEvent::ToolBarChange:
-      classId = smoke->idClass("QToolBarChangeEvent").index;
-      break;
-    case QEvent::ApplicationActivated:
-    case QEvent::ApplicationDeactivated:
-    case QEvent::QueryWhatsThis:
-    case QEvent::EnterWhatsThisMode:
-    case QEvent::LeaveWhatsThisMode:
-    case QEvent::ZOrderChange:
-      classId = smoke->idClass("QEvent").index;
-      break;
-    case QEvent::HoverEnter:
-    case QEvent::HoverLeave:
-    case QEvent::HoverMove:
-      classId = smoke->idClass("QHoverEvent").index;
-      break;
-    case QEvent::GraphicsSceneMouseMove:
-    case QEvent::GraphicsSceneMousePress:
-    case QEvent::GraphicsSceneMouseRelease:
-    case QEvent::GraphicsSceneMouseDoubleClick:
-      classId = smoke->idClass("QGraphicsSceneMouseEvent").index;
-      break;
-    case QEvent::GraphicsSceneContextMenu:
-      classId = smoke->idClass("QGraphicsSceneContextMenuEvent").index;
-      break;
-    case QEvent::GraphicsSceneHoverEnter:
-    case QEvent::GraphicsSceneHoverMove:
-    case QEvent::GraphicsSceneHoverLeave:
-      classId = smoke->idClass("QGraphicsSceneHoverEvent").index;
-      break;
-    case QEvent::GraphicsSceneHelp:
-      classId = smoke->idClass("QGraphicsSceneHelpEvent").index;
-      break;
-    case QEvent::GraphicsSceneDragEnter:
-    case QEvent::GraphicsSceneDragMove:
-    case QEvent::GraphicsSceneDragLeave:
-    case QEvent::GraphicsSceneDrop:
-      classId = smoke->idClass("QGraphicsSceneDragDropEvent").index;
-      break;
-    case QEvent::GraphicsSceneWheel:
-      classId = smoke->idClass("QGraphicsSceneWheelEvent").index;
-      break;
-    case QEvent::KeyboardLayoutChange:
-      classId = smoke->idClass("QEvent").index;
-      break;
-    case QEvent::TouchEnd:
-    case QEvent::TouchCancel:
-    case QEvent::TouchBegin:
-    case QEvent::TouchUpdate:
-      classId = smoke->idClass("QTouchEvent").index;
-      break;
-    case QEvent::Gesture:
-    case QEvent::GestureOverride:
-      classId = smoke->idClass("QGestureEvent").index;
-      break;
-    case QEvent::InputMethodQuery:
-      classId = smoke->idClass("QInputMethodQueryEvent").index;
-      break;
-    case QEvent::ScrollPrepare:
-      classId = smoke->idClass("QScrollPrepareEvent").index;
-      break;
-    case QEvent::Scroll:
-      classId = smoke->idClass("QScrollEvent").index;
-      break;
-    default:
-      break;
-    }
-  } else if (smoke->isDerivedFrom(className, "QAccessibleEvent")) {
+    classId = metaClass(smoke, obj->metaObject());
+  } else if (SmokeModule::isDerivedFrom(smoke, classId, "QEvent")) {
+    ClassResolver *r = resolver(smoke);
+    Smoke::Index qeventId = r ? r->eventClass : smoke->idClass("QEvent").index;
+    QEvent * qevent = (QEvent *) smoke->cast(o->ptr(), classId, qeventId);
+    classId = eventClass(smoke, qevent->type(), classId);
+  } else if (SmokeModule::isDerivedFrom(smoke, classId, "QAccessibleEvent")) {
     QAccessibleEvent * aevent = (QAccessibleEvent *)
       smoke->cast(o->ptr(), classId, smoke->idClass("QAccessibleEvent").index);
     switch (aevent->type()) {
@@ -304,7 +325,7 @@ resolve_classname_qt(const SmokeObject * o)
     default:
       break;
     }
-  } else if (smoke->isDerivedFrom(className, "QGraphicsItem")) {
+  } else if (SmokeModule::isDerivedFrom(smoke, classId, "QGraphicsItem")) {
     QGraphicsItem * item = (QGraphicsItem *)
       smoke->cast(o->ptr(), classId,
                      smoke->idClass("QGraphicsItem").index);
@@ -340,7 +361,7 @@ resolve_classname_qt(const SmokeObject * o)
       classId = smoke->idClass("QGraphicsItemGroup").index;
       break;
     }
-  } else if (smoke->isDerivedFrom(className, "QLayoutItem")) {
+  } else if (SmokeModule::isDerivedFrom(smoke, classId, "QLayoutItem")) {
     QLayoutItem * item = (QLayoutItem *)
       smoke->cast(o->ptr(), classId,
                      smoke->idClass("QLayoutItem").index);
@@ -446,6 +467,7 @@ Smoke *registerSmokeModule(Smoke *smoke /* resolveClass, memoryIsOwned */)
   SmokeModule *module = new SmokeModule(binding, resolve_classname_qt,
                                     memory_is_owned_qt);
   SmokeModule::registerModule(module);
+  createResolver(smoke);
   return smoke;
 }
 
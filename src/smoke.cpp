@@ -119,6 +119,27 @@ SEXP qt_qenums(SEXP klass) {
   return result;
 }
 
+/* The QtEnum values of a class, as a named list. These are the same
+   objects that are found in instance environments. */
+extern "C"
+SEXP qt_qenumValues(SEXP klass) {
+  SEXP result, resultNames;
+  const Class *c = Class::fromSexp(klass);
+  QList<const char *> enumNames = c->enumValues().keys();
+  
+  PROTECT(result = allocVector(VECSXP, enumNames.size()));
+  resultNames = allocVector(STRSXP, length(result));
+  setAttrib(result, R_NamesSymbol, resultNames);
+  
+  for (int i = 0; i < length(result); i++) {
+    SET_VECTOR_ELT(result, i, c->enumValue(enumNames[i]));
+    SET_STRING_ELT(resultNames, i, mkChar(enumNames[i]));
+  }
+  
+  UNPROTECT(1);
+  return result;
+}
+
 extern "C"
 SEXP qt_qparentClasses(SEXP klass) {
   SEXP result;
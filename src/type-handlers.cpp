@@ -246,10 +246,82 @@ void marshal_to_sexp<SmokeClassWrapper>(MethodCall *m)
   */
   bool constructed = m->returning() &&
     m->method()->qualifiers() & Method::Constructor;
-  SEXP sexp = ptr_to_sexp(p, m->type(), constructed);
+  SEXP sexp;
+  /* A value returned on the stack is new to R, so it can start out as
+     a handle, promoted to an environment on demand */
+  if (p && m->returning() && m->type().isStack() && handlesEnabled()) {
+    SmokeObject *so = SmokeObject::fromPtr(p, m->type(), true);
+    sexp = so->hasSexp() ? so->sexp() : so->handleSexp();
+  } else sexp = ptr_to_sexp(p, m->type(), constructed);
   m->setSexp(sexp);
 }
 
+/* unboxed values (see convert.cpp) */
+
+template <typename T>
+static void marshal_unboxed(MethodCall *m, UnboxedType unboxed)
+{
+  if (m->mode() == MethodCall::RToSmoke) {
+    T value = from_sexp<T>(unboxedValue(m->sexp(), unboxed));
+    if (m->returning()) { // from a virtual, smoke frees this
+      setItemValue(m, (void *)new T(value));
+      return;
+    }
+    setItemValue(m, (void *)&value);
+    m->marshal();
+    if (m->itemIsMutable())
+      m->setSexp(unboxedSexp(to_sexp(value), unboxed));
+  } else {
+    T *qp = (T *)itemValue<void *>(m);
+    m->setSexp(qp ? unboxedSexp(to_sexp(*qp), unboxed) : R_NilValue);
+    if (qp && m->type().isStack()) // returned by value, we own it
+      delete qp;
+  }
+}
+
+/* Values are unboxed when passed from R as unboxed, or returned by
+   value (or const reference) to R while unboxing is enabled */
+static bool marshal_unboxed(MethodCall *m)
+{
+  const SmokeType &type = m->type();
+  UnboxedType unboxed = NotUnboxed;
+  if (m->mode() == MethodCall::RToSmoke) {
+    unboxed = unboxedType(m->sexp());
+    if (unboxed && unboxed != unboxedType(type))
+      unboxed = NotUnboxed;
+  } else if (m->returning() && m->mode() == MethodCall::SmokeToR &&
+             (type.isStack() || (type.isConst() && type.isRef()))) {
+    unboxed = unboxedType(type);
+    if (unboxed && !unboxingEnabled())
+      unboxed = NotUnboxed;
+  }
+  switch(unboxed) {
+  case UnboxedQPointF:
+    marshal_unboxed<QPointF>(m, unboxed);
+    break;
+  case UnboxedQSizeF:
+    marshal_unboxed<QSizeF>(m, unboxed);
+    break;
+  case UnboxedQRectF:
+    marshal_unboxed<QRectF>(m, unboxed);
+    break;
+  case UnboxedQColor:
+    marshal_unboxed<QColor>(m, unboxed);
+    break;
+  case UnboxedQTransform:
+    marshal_unboxed<QTransform>(m, unboxed);
+    break;
+#if QT_VERSION >= 0x50300
+  case UnboxedQMarginsF:
+    marshal_unboxed<QMarginsF>(m, unboxed);
+    break;
+#endif
+  default:
+    return false;
+  }
+  return true;
+}
+
 void marshal_basetype(MethodCall *m)
 {
   switch(m->type().elem()) {
@@ -306,7 +378,8 @@ void marshal_basetype(MethodCall *m)
     {
       if (!qstrcmp(m->type().className(), "QVariant"))
         marshal<QVariant>(m); /* special-case QVariant */
-      else marshal<SmokeClassWrapper>(m);
+      else if (!marshal_unboxed(m))
+        marshal<SmokeClassWrapper>(m);
     }
     break;
 
@@ -342,11 +415,41 @@ void marshal_unknown(MethodCall *m) {
    ranks for all of its parameters is selected. If there is a tie for
    the best method, there is an error (in our code).
 */
+/* For an instance environment or handle */
+static int scoreArg_object(SEXP value, const SmokeType &type) {
+  int score = 0;
+  if (type.elem() == Smoke::t_class) {
+    SmokeObject *o = SmokeObject::fromSexp(value);
+    if (o) {
+      const char *smokeClass = type.className();
+      if (o->className() == smokeClass)
+        score = 3;
+      else if (o->instanceOf(smokeClass))
+        score = 2;
+      /* Not clear if we want to support this C++ feature
+      else {
+        Method *m = Class::fromSmokeType(type)->findImplicitConverter(o);
+        if (m) {
+          score = 1;
+          delete m;
+        }
+      }
+      */
+    }
+  }
+  return score;
+}
+
 int scoreArg_basetype(SEXP arg, const SmokeType &type) {
   int score = 0;
   SEXP value = arg;
   int rtype = TYPEOF(value);
   unsigned short elem = type.elem();
+  if (elem == Smoke::t_class && OBJECT(value) && rtype != ENVSXP) {
+    UnboxedType unboxed = unboxedType(value);
+    if (unboxed)
+      return unboxed == unboxedType(type) ? 3 : 0;
+  }
   switch(rtype) { // try the simple cases first
   case RAWSXP:
     switch(elem) {
@@ -425,26 +528,12 @@ int scoreArg_basetype(SEXP arg, const SmokeType &type) {
     if (elem == Smoke::t_char && strlen(CHAR(asChar(value))) == 1)
       score = 2;
     break;
+  case EXTPTRSXP:
+    if (SmokeObject::isHandle(value))
+      score = scoreArg_object(value, type);
+    break;
   case ENVSXP:
-    if (elem == Smoke::t_class) {
-      SmokeObject *o = SmokeObject::fromSexp(value);
-      if (o) {
-        const char *smokeClass = type.className();
-        if (o->className() == smokeClass)
-          score = 3;
-        else if (o->instanceOf(smokeClass))
-          score = 2;
-        /* Not clear if we want to support this C++ feature
-        else {
-          Method *m = Class::fromSmokeType(type)->findImplicitConverter(o);
-          if (m) {
-            score = 1;
-            delete m;
-          }
-        }
-        */
-      }
-    }
+    score = scoreArg_object(value, type);
     break;
   case NILSXP:
     if (type.isPtr())
@@ -23,8 +23,23 @@
       reinterpret_cast<ctype *>(R_ExternalPtrAddr(x));                  \
     })
 
+/* For pointers that carry an identity tag, a pointer comparison
+   replaces the walk of the class attribute in inherits() */
+#define checkPointerTag(x, tag, type) ({                                \
+      if (TYPEOF(x) != EXTPTRSXP || R_ExternalPtrTag(x) != (tag))        \
+        checkPointer(x, type);                                          \
+    })
+
 #define unwrapPointer(x, type) unwrapPointerSep(x, type, type)
 
+/* Marks a vector that is shared between R objects, so that R
+   duplicates it before any modification */
+#ifdef MARK_NOT_MUTABLE
+#define markShared(x) MARK_NOT_MUTABLE(x)
+#else
+#define markShared(x) SET_NAMED(x, 2)
+#endif
+
 void *_unwrapSmoke(SEXP x, const char *type);
 #define unwrapSmoke(x, type) reinterpret_cast<type *>(_unwrapSmoke(x, #type))
 
@@ -0,0 +1,90 @@
+/* Checks the hash indices of Smoke names (idType, idClass,
+   idMethodName, idMethod and findClass) against a small module. This
+   needs only smoke.h, so it is built by hand, not by R CMD check:
+
+   g++ -I src/kdebindings/smoke tests/smoke-index.cpp -o smoke-index
+   ./smoke-index
+*/
+
+#include <smoke.h>
+#include <cstdio>
+
+Smoke::ClassMap Smoke::classMap;
+Smoke::ClassIndex Smoke::classIndex;
+Smoke::ModuleIndex Smoke::NullModuleIndex;
+
+static int failures = 0;
+
+static void check(long actual, long expected, const char *what) {
+  if (actual != expected) {
+    printf("FAIL: %s is %ld, expected %ld\n", what, actual, expected);
+    failures++;
+  }
+}
+
+static Smoke::Class classes[] = {
+  { 0, false, 0, 0, 0, 0, 0 },
+  { "A", false, 0, 0, 0, 0, 0 },
+  { "B", true, 0, 0, 0, 0, 0 }, // external
+  { "C", false, 0, 0, 0, 0, 0 }
+};
+static const char *methodNames[] = { 0, "bar", "foo" };
+static Smoke::MethodMap methodMaps[] = {
+  { 0, 0, 0 }, { 1, 1, 1 }, { 1, 2, 2 }, { 3, 2, 3 }
+};
+static Smoke::Type types[] = {
+  { 0, 0, 0 }, { "A*", 1, 0 }, { "int", 0, 0 }
+};
+
+int main() {
+  Smoke *smoke = new Smoke("test", classes, 3, 0, 0, methodMaps, 3,
+                           methodNames, 2, types, 2, 0, 0, 0, 0);
+
+  check(smoke->idType("A*"), 1, "idType(A*)");
+  check(smoke->idType("int"), 2, "idType(int)");
+  check(smoke->idType("double"), 0, "idType(double)");
+
+  check(smoke->idClass("A").index, 1, "idClass(A)");
+  check(smoke->idClass("C").index, 3, "idClass(C)");
+  check(smoke->idClass("B").index, 0, "idClass(B)");
+  check(smoke->idClass("B", true).index, 2, "idClass(B, external)");
+  check(smoke->idClass("D").index, 0, "idClass(D)");
+
+  check(smoke->idMethodName("bar").index, 1, "idMethodName(bar)");
+  check(smoke->idMethodName("foo").index, 2, "idMethodName(foo)");
+  check(smoke->idMethodName("baz").index, 0, "idMethodName(baz)");
+
+  check(smoke->idMethod(1, 1).index, 1, "idMethod(A, bar)");
+  check(smoke->idMethod(1, 2).index, 2, "idMethod(A, foo)");
+  check(smoke->idMethod(3, 2).index, 3, "idMethod(C, foo)");
+  check(smoke->idMethod(3, 1).index, 0, "idMethod(C, bar)");
+
+  check(Smoke::findClass("A").index, 1, "findClass(A)");
+  check(Smoke::findClass("B").index, 0, "findClass(B)"); // only external
+  check(Smoke::findClass("A").smoke == smoke, 1, "findClass(A).smoke");
+
+  /* enough modules to grow the cross-module index several times */
+  const int nmodules = 2000;
+  for (int i = 0; i < nmodules; i++) {
+    char *name = new char[16];
+    sprintf(name, "K%d", i);
+    Smoke::Class *moduleClasses = new Smoke::Class[2]();
+    moduleClasses[1].className = name;
+    new Smoke("module", moduleClasses, 1, 0, 0, methodMaps, 0, methodNames, 0,
+              types, 0, 0, 0, 0, 0);
+  }
+  check(Smoke::findClass("K0").index, 1, "findClass(K0)");
+  check(Smoke::findClass("K1999").index, 1, "findClass(K1999)");
+  check(Smoke::findClass("A").smoke == smoke, 1, "findClass(A) after growth");
+  check(Smoke::classIndex.size, nmodules + 2, "classIndex.size");
+
+  /* a later module overrides a class, as in classMap */
+  Smoke *later = new Smoke("later", classes, 3, 0, 0, methodMaps, 3,
+                           methodNames, 2, types, 2, 0, 0, 0, 0);
+  check(Smoke::findClass("A").smoke == later, 1, "findClass(A) overridden");
+  check(Smoke::classIndex.size, nmodules + 2, "classIndex.size overridden");
+
+  if (!failures)
+    printf("OK\n");
+  return failures != 0;
+}